@@ -22,49 +22,94 @@ Experimental script for automatic sorting of errors, basing on failed optimizati
 ###############################################################################
 
 import logging
+import multiprocessing
 import os
 import re
-
+import shutil
+import tempfile
 
 import common
 import gen_test_makefile
+import obj_cache
 import run_gen
 
 
 icc_blame_opts = ["-from_rtn=0 -to_rtn=", "-num_opt=", "-num-case="]
-icc_opt_patterns = ["\(\d+\)", "\(\d+\)\s*\n", "DO ANOTHER.*\(\d+\)"]
-icc_opt_name_prefix = "DOING\s*\[\w*\]\s*"
-icc_opt_name_suffix = "\s*\(\d*\)\s*\(last opt\)"
-
-compilers_blame_opts = {"icc": icc_blame_opts}
-compilers_blame_patterns = {"icc": icc_opt_patterns}
-compilers_opt_name_cutter = {"icc": [icc_opt_name_prefix, icc_opt_name_suffix]}
+icc_opt_patterns = [r"\(\d+\)", r"\(\d+\)\s*\n", r"DO ANOTHER.*\(\d+\)"]
+icc_opt_name_prefix = r"DOING\s*\[\w*\]\s*"
+icc_opt_name_suffix = r"\s*\(\d*\)\s*\(last opt\)"
+
+# LLVM numbers every pass, which can be skipped, and runs only first N of them with -opt-bisect-limit=N
+clang_blame_opts = ["-mllvm -opt-bisect-limit="]
+clang_opt_patterns = [r"BISECT: running pass \(\d+\)"]
+clang_opt_name_prefix = r"BISECT: running pass \(\d+\)\s*"
+clang_opt_name_suffix = r"\s+on\s.*"
+
+# Every phase of blaming is a flag, which limits number of optimizations (it is passed to compiler with -1 first
+# to get the number of optimizations from compiler's output with the pattern of the phase)
+compilers_blame_opts = {"icc": icc_blame_opts, "clang": clang_blame_opts}
+compilers_blame_patterns = {"icc": icc_opt_patterns, "clang": clang_opt_patterns}
+compilers_opt_name_cutter = {"icc": [icc_opt_name_prefix, icc_opt_name_suffix],
+                             "clang": [clang_opt_name_prefix, clang_opt_name_suffix]}
 
 blame_test_makefile_name = "Blame_Makefile"
+# Number of optimization numbers, which are checked in parallel in every round of bisection
+blame_jobs = 1
 
 ###############################################################################
 
 
-def get_next_step(start, end, current, fail_flag):
-    if fail_flag:
-        next_start = start
-        next_current = (current - start) // 2 + start
-        next_end = current
-    else:
-        next_start = current
-        next_current = (end - current) // 2 + current
-        next_end = end
-    return next_start, next_end, next_current
+def set_blame_jobs(jobs):
+    global blame_jobs
+    if jobs < 1:
+        common.print_and_exit("Number of blame jobs should be positive")
+    blame_jobs = jobs
+
+
+# Returns up to k optimization numbers, which split (start, end) into k + 1 equal parts
+def get_probes(start, end, k):
+    return sorted(set([start + (end - start) * (i + 1) // (k + 1) for i in range(k)]) - {start, end})
+
 
+# Returns True if the test fails, when optimizations are limited with inject_str. It is run in probe_dir, so several
+# optimization numbers can be checked at once.
+def run_probe(probe_dir, valid_res, fail_target_name, inject_str, num):
+    os.chdir(probe_dir)
+    fail_target = gen_test_makefile.CompilerTarget.get_target(fail_target_name)
+    gen_test_makefile.gen_makefile(blame_test_makefile_name, True, None, fail_target, inject_str)
+    ret_code, output, err_output, time_expired, elapsed_time = \
+        obj_cache.run_make(blame_test_makefile_name, fail_target.name, run_gen.compiler_timeout, num)
+    if time_expired or ret_code != 0:
+        common.log_msg(logging.DEBUG, "#" + str(num) + " Compilation failed")
+        return True
 
-def execute_blame_phase(valid_res, fail_target, inject_str, num, phase_num):
-    gen_test_makefile.gen_makefile(blame_test_makefile_name, True, None, fail_target, inject_str + "-1")
     ret_code, output, err_output, time_expired, elapsed_time = \
-        common.run_cmd(["make", "-f", blame_test_makefile_name, fail_target.name], run_gen.compiler_timeout, num)
+        common.run_cmd(["make", "-f", blame_test_makefile_name, "run_" + fail_target.name], run_gen.run_timeout, num)
+    if time_expired or ret_code != 0:
+        common.log_msg(logging.DEBUG, "#" + str(num) + " Execution failed")
+        return True
+
+    if str(output, "utf-8").split()[-len(valid_res):] != valid_res:
+        common.log_msg(logging.DEBUG, "#" + str(num) + " Out differs")
+        return True
+    return False
+
+
+# Compiler's output is parsed, so the build doesn't use object cache (cached compilation doesn't print anything)
+def make_with_output(fail_target, inject_str, num):
+    gen_test_makefile.gen_makefile(blame_test_makefile_name, True, None, fail_target, inject_str)
+    return common.run_cmd(["make", "-f", blame_test_makefile_name, fail_target.name], run_gen.compiler_timeout, num)
+
+
+# Searches for the earliest optimization number, which fails the test. Test is expected to pass with 0 and to fail
+# with the maximal number. Every round checks len(probe_dirs) numbers at once with the pool and shrinks the interval
+# len(probe_dirs) + 1 times (it is usual binary search with one probe dir).
+def execute_blame_phase(valid_res, fail_target, inject_str, num, phase_num, probe_dirs, pool):
+    ret_code, output, err_output, time_expired, elapsed_time = make_with_output(fail_target, inject_str + "-1", num)
     opt_num_regex = re.compile(compilers_blame_patterns[fail_target.specs.name][phase_num])
     try:
         max_opt_num_str = opt_num_regex.findall(str(err_output, "utf-8"))[-1]
-        remove_brackets_pattern = re.compile("\d+")
+        remove_brackets_pattern = re.compile(r"\d+")
         max_opt_num = int(remove_brackets_pattern.findall(max_opt_num_str)[-1])
         common.log_msg(logging.DEBUG, "Max opt num: " + str(max_opt_num))
     except IndexError:
@@ -73,73 +118,54 @@ def execute_blame_phase(valid_res, fail_target, inject_str, num, phase_num):
 
     start_opt = 0
     end_opt = max_opt_num
-    cur_opt = max_opt_num
-    failed_flag = True
-    time_to_finish = False
-    while not time_to_finish:
-        start_opt, end_opt, cur_opt = get_next_step(start_opt, end_opt, cur_opt, failed_flag)
-        common.log_msg(logging.DEBUG, "Previous failed: " + str(failed_flag))
-        failed_flag = False
-        eff = ((start_opt + 1) == cur_opt)  # Earliest fail was found
-
-        common.log_msg(logging.DEBUG, "Trying opt: " + str(start_opt) + "/" + str(cur_opt) + "/" + str(end_opt))
-        gen_test_makefile.gen_makefile(blame_test_makefile_name, True, None, fail_target, inject_str + str(cur_opt))
-
-        ret_code, output, err_output, time_expired, elapsed_time = \
-            common.run_cmd(["make", "-f", blame_test_makefile_name, fail_target.name], run_gen.compiler_timeout, num)
-        if time_expired or ret_code != 0:
-            common.log_msg(logging.DEBUG, "#" + str(num) + " Compilation failed")
-            failed_flag = True
-            if not eff:
-                continue
-            else:
-                break
-
-        ret_code, output, err_output, time_expired, elapsed_time = \
-            common.run_cmd(["make", "-f", blame_test_makefile_name, "run_" + fail_target.name], run_gen.run_timeout, num)
-        if time_expired or ret_code != 0:
-            common.log_msg(logging.DEBUG, "#" + str(num) + " Execution failed")
-            failed_flag = True
-            if not eff:
-                continue
-            else:
-                break
-
-        if str(output, "utf-8").split()[-1] != valid_res:
-            common.log_msg(logging.DEBUG, "#" + str(num) + " Out differs")
-            failed_flag = True
-            if not eff:
-                continue
-            else:
+    while end_opt - start_opt > 1:
+        probes = get_probes(start_opt, end_opt, len(probe_dirs))
+        common.log_msg(logging.DEBUG, "Trying opts: " + str(start_opt) + "/" + str(probes) + "/" + str(end_opt))
+        args = [(probe_dirs[i], valid_res, fail_target.name, inject_str + str(probes[i]), num)
+                for i in range(len(probes))]
+        if pool is not None:
+            fails = pool.starmap(run_probe, args)
+        else:
+            fails = [run_probe(*i) for i in args]
+        for opt, failed in zip(probes, fails):
+            if failed:
+                end_opt = opt
                 break
+            start_opt = opt
+    return str(end_opt)
 
-        time_to_finish = (eff and failed_flag) or (eff and not failed_flag and (cur_opt == (end_opt - 1)))
-        common.log_msg(logging.DEBUG, "Time to finish: " + str(time_to_finish))
 
-    if not failed_flag:
-        common.log_msg(logging.DEBUG, "Swapping current and end opt")
-        cur_opt = end_opt
-
-    return str(cur_opt)
-
-
-def blame(fail_dir, valid_res, fail_target, out_dir, lock, num):
+# With several blame jobs, optimization numbers are checked in parallel in temporary copies of the test
+def blame(fail_dir, valid_res, fail_target, out_dir, num):
     blame_str = ""
     blame_opts = compilers_blame_opts[fail_target.specs.name]
     phase_num = 0
+    probe_dirs = [fail_dir]
+    pool = None
+    if blame_jobs > 1:
+        probe_dirs = [tempfile.mkdtemp(prefix=common.tmp_dir_prefix, dir=fail_dir) for i in range(blame_jobs)]
+        for i in probe_dirs:
+            for j in gen_test_makefile.sources.value.split() + gen_test_makefile.headers.value.split():
+                common.link_or_copy(os.path.join(fail_dir, j), i)
+        pool = multiprocessing.Pool(blame_jobs)
     try:
         for i in blame_opts:
             blame_str += i
-            blame_str += execute_blame_phase(valid_res, fail_target, blame_str, num, phase_num)
+            blame_str += execute_blame_phase(valid_res, fail_target, blame_str, num, phase_num, probe_dirs, pool)
             blame_str += " "
             phase_num += 1
     except:
         common.log_msg(logging.ERROR, "Something went wrong while executing bpame_opt.py on " + str(fail_dir))
         return False
+    finally:
+        os.chdir(fail_dir)
+        if pool is not None:
+            pool.close()
+            pool.join()
+            for i in probe_dirs:
+                shutil.rmtree(i)
 
-    gen_test_makefile.gen_makefile(blame_test_makefile_name, True, None, fail_target, blame_str)
-    ret_code, output, err_output, time_expired, elapsed_time = \
-        common.run_cmd(["make", "-f", blame_test_makefile_name, fail_target.name], run_gen.compiler_timeout, num)
+    ret_code, output, err_output, time_expired, elapsed_time = make_with_output(fail_target, blame_str, num)
 
     opt_name_pattern = re.compile(compilers_opt_name_cutter[fail_target.specs.name][0] + ".*" +
                                   compilers_opt_name_cutter[fail_target.specs.name][1])
@@ -152,17 +178,18 @@ def blame(fail_dir, valid_res, fail_target, out_dir, lock, num):
 
     seed_dir = os.path.basename(os.path.normpath(fail_dir))
     full_out_path = os.path.join(os.path.join(out_dir, opt_name), seed_dir)
-    common.copy_test_to_out(fail_dir, full_out_path, lock)
+    common.copy_test_to_out(fail_dir, full_out_path)
     with common.check_and_open_file(os.path.join(full_out_path, "log.txt"), "a") as log_file:
         log_file.write("\nBlame opts: " + blame_str + "\n")
     common.log_msg(logging.DEBUG, "Done blaming")
     return True
 
 
-def prepare_env_and_blame(fail_dir, valid_res, fail_target, out_dir, lock, num):
+def prepare_env_and_blame(fail_dir, valid_res, fail_target, out_dir, num):
     common.log_msg(logging.DEBUG, "Blaming target: " + fail_target.name + " | " + fail_target.specs.name)
     os.chdir(fail_dir)
+    gen_test_makefile.detect_out_profile(fail_dir)
     if fail_target.specs.name not in compilers_blame_opts:
         common.log_msg(logging.DEBUG, "We can't blame " + fail_target.name)
         return False
-    return blame(fail_dir, valid_res, fail_target, out_dir, lock, num)
+    return blame(fail_dir, valid_res, fail_target, out_dir, num)
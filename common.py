@@ -23,11 +23,19 @@ File for common data and functions, which are used in scripts
 
 import datetime
 import errno
+import fcntl
+import itertools
 import logging
 import os
+import re
+import select
+import shlex
 import shutil
+import signal
 import subprocess
 import sys
+import tempfile
+import time
 
 # $YARPGEN_HOME environment variable should be set to YARP Generator directory
 yarpgen_home = os.environ["YARPGEN_HOME"] if "YARPGEN_HOME" in os.environ else os.getcwd()
@@ -40,6 +48,25 @@ __duplicate_err_to_stderr__ = False
 stat_logger_name = "stat_logger"
 stat_logger = None
 
+# Prefix of temporary dirs, which are renamed to saved tests (see publish_dir)
+tmp_dir_prefix = ".tmp_"
+# ioctl, which clones file (reflink) on file systems with copy-on-write (btrfs, xfs)
+FICLONE = 0x40049409
+# mkdtemp creates dirs, which are accessible only by owner, so published dirs get usual mode of new dirs (see umask)
+umask = os.umask(0)
+os.umask(umask)
+published_dir_mode = 0o777 & ~umask
+
+# Limits of every command, which is started by run_cmd with limited=True (None means no limit).
+# Memory limit (MB) is a limit of RSS, which is enforced only by memory.max of child cgroup of job_cgroup (otherwise it
+# is used only for admission of jobs). Cpu limit is in seconds.
+job_mem_limit = None
+job_cpu_limit = None
+job_cgroup = None
+job_cgroup_ids = itertools.count()
+# Errors of compilers, which have exceeded cpu limit
+cpu_limit_err_re = re.compile(rb"CPU time limit exceeded|Killed")
+
 
 def print_and_exit(msg):
     log_msg(logging.ERROR, msg)
@@ -120,18 +147,65 @@ def check_and_copy(src, dst):
         print_and_exit("File " + norm_src + " wasn't found")
 
 
-def copy_test_to_out(test_dir, out_dir, lock):
-    log_msg(logging.DEBUG, "Copying " + test_dir + " to " + out_dir)
-    lock.acquire()
+# File is hard-linked, if it is possible (source and destination are on the same file system), or cloned (reflink),
+# if file system supports it. Otherwise it is copied. Linked files shouldn't be modified.
+def link_or_copy(src, dst):
+    if os.path.isdir(dst):
+        dst = os.path.join(dst, os.path.basename(src))
+    try:
+        os.link(src, dst)
+        return dst
+    except OSError:
+        pass
+    return clone_or_copy(src, dst)
+
+
+# Clone (reflink) doesn't share changes with its source, so it is used for files, which can be modified
+def clone_or_copy(src, dst):
+    if os.path.isdir(dst):
+        dst = os.path.join(dst, os.path.basename(src))
+    try:
+        with open(src, "rb") as src_file, open(dst, "wb") as dst_file:
+            fcntl.ioctl(dst_file.fileno(), FICLONE, src_file.fileno())
+        return dst
+    except OSError:
+        pass
+    shutil.copy(src, dst)
+    return dst
+
+
+# Temporary dir is created next to its destination, so it can be renamed (see publish_dir)
+def make_tmp_dir(dest):
+    os.makedirs(os.path.dirname(dest), exist_ok=True)
+    return tempfile.mkdtemp(prefix=tmp_dir_prefix, dir=os.path.dirname(dest))
+
+
+# Filled temporary dir is renamed to its destination, so it appears atomically without locks.
+# If destination already exists, temporary dir is removed and False is returned.
+def publish_dir(tmp_dir, dest):
     try:
-        shutil.copytree(test_dir, out_dir)
+        os.chmod(tmp_dir, published_dir_mode)
+        os.rename(tmp_dir, dest)
+        return True
     except OSError as e:
-        if e.errno == errno.EEXIST:
-            pass
-        else:
+        if e.errno not in (errno.EEXIST, errno.ENOTEMPTY):
             raise
-    finally:
-        lock.release()
+        shutil.rmtree(tmp_dir, ignore_errors=True)
+        return False
+
+
+# Test is copied, if it isn't in out_dir yet. Files aren't linked, because copied tests are edited by hand
+# (e.g. reduced), and it would change the original tests.
+def copy_test_to_out(test_dir, out_dir):
+    log_msg(logging.DEBUG, "Copying " + test_dir + " to " + out_dir)
+    if os.path.exists(out_dir):
+        return
+    # copytree creates its destination, so the test is copied to subdir of temporary dir
+    tmp_dir = make_tmp_dir(out_dir)
+    tmp_test_dir = os.path.join(tmp_dir, "test")
+    shutil.copytree(test_dir, tmp_test_dir, copy_function=clone_or_copy)
+    publish_dir(tmp_test_dir, out_dir)
+    shutil.rmtree(tmp_dir, ignore_errors=True)
 
 
 def check_if_dir_exists(directory):
@@ -145,37 +219,299 @@ def check_dir_and_create(directory):
     norm_dir = os.path.abspath(directory)
     if not os.path.exists(norm_dir):
         log_msg(logging.DEBUG, "Creating '" + str(norm_dir) + "' directory")
-        os.makedirs(norm_dir)
+        # Directory can be created by other process at the same time
+        os.makedirs(norm_dir, exist_ok=True)
     elif not os.path.isdir(norm_dir):
         print_and_exit("Can't use '" + norm_dir + "' directory")
 
 
-def run_cmd(cmd, time_out=None, num=-1):
+def set_job_limits(mem_limit, cpu_limit, cgroup=None):
+    global job_mem_limit
+    global job_cpu_limit
+    global job_cgroup
+    job_mem_limit = mem_limit
+    job_cpu_limit = cpu_limit
+    job_cgroup = os.path.abspath(cgroup) if cgroup is not None and mem_limit is not None else None
+    # Unusable cgroup is reported right away, instead of unlimited compilations
+    if job_cgroup is not None:
+        cgroup_dir = create_job_cgroup()
+        if cgroup_dir is None:
+            print_and_exit("Can't create cgroup with memory limit in " + job_cgroup)
+        remove_job_cgroup(cgroup_dir)
+
+
+# Returns new child cgroup of job_cgroup with memory limit (or None, if it can't be created)
+def create_job_cgroup():
+    cgroup_dir = os.path.join(job_cgroup, "job_" + str(os.getpid()) + "_" + str(next(job_cgroup_ids)))
+    try:
+        os.mkdir(cgroup_dir)
+        # memory.max isn't created, so dir without memory controller isn't taken for cgroup
+        with open(os.path.join(cgroup_dir, "memory.max"), "r+") as max_file:
+            max_file.write(str(job_mem_limit * 2 ** 20))
+    except OSError as err:
+        log_msg(logging.ERROR, "Can't create cgroup " + cgroup_dir + ": " + str(err))
+        remove_job_cgroup(cgroup_dir)
+        return None
+    # Swap would let the command exceed the limit, but swap controller can be unavailable
+    try:
+        with open(os.path.join(cgroup_dir, "memory.swap.max"), "r+") as swap_file:
+            swap_file.write("0")
+    except OSError:
+        pass
+    return cgroup_dir
+
+
+# Returns number of processes, which were killed by memory limit of the cgroup
+def get_cgroup_oom_kills(cgroup_dir):
+    try:
+        with open(os.path.join(cgroup_dir, "memory.events"), "r") as events_file:
+            for line in events_file:
+                if line.startswith("oom_kill "):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    return 0
+
+
+# cgroup can't be removed, while it has processes (e.g. leaked daemons of the command), so it is left in this case
+def remove_job_cgroup(cgroup_dir):
+    try:
+        os.rmdir(cgroup_dir)
+    except OSError:
+        log_msg(logging.DEBUG, "Can't remove cgroup " + cgroup_dir)
+
+
+# Command is started by shell, which sets limits with ulimit (and joins cgroup_dir, if it is set) and execs it, so
+# limits are inherited by all processes of the command. Limits aren't set in the child process before exec
+# (preexec_fn), because it isn't safe in multithreaded process and prevents fast start of the process (vfork or
+# posix_spawn).
+def get_limited_cmd(cmd, cgroup_dir=None):
+    limits = []
+    if cgroup_dir is not None:
+        limits.append("echo $$ > " + shlex.quote(os.path.join(cgroup_dir, "cgroup.procs")))
+    if job_cpu_limit is not None:
+        # SIGXCPU is sent at soft limit, SIGKILL - at hard limit. Hard limit can't be below soft limit, so soft limit
+        # is lowered first.
+        limits += ["ulimit -S -t " + str(job_cpu_limit), "ulimit -H -t " + str(job_cpu_limit + 1)]
+    if len(limits) == 0:
+        return cmd
+    return ["sh", "-c", " && ".join(limits) + ' && exec "$@"', "sh"] + cmd
+
+
+# Checks if failed command (started with limited=True) was killed by the limits. Kill by memory limit is reported by
+# its cgroup (OOM kills of the system aren't counted). Signal of cpu limit is counted only if the limit is set and
+# cpu time of the command (rusage) has reached it.
+def is_killed_by_limit(ret_code, err_output, rusage, oom_kills=0):
+    if oom_kills > 0:
+        return True
+    if job_cpu_limit is None:
+        return False
+    killed = ret_code in (-signal.SIGXCPU, -signal.SIGKILL) or cpu_limit_err_re.search(err_output) is not None
+    # Cpu time of rusage is less precise than the accounting of the limit
+    return killed and rusage.ru_utime + rusage.ru_stime >= job_cpu_limit * 0.95
+
+
+# Returns value of the field of /proc/meminfo in MB (or None, if it is unavailable)
+def get_mem_info(field):
+    try:
+        with open("/proc/meminfo", "r") as mem_info:
+            for line in mem_info:
+                if line.startswith(field + ":"):
+                    return int(line.split()[1]) // 1024
+    except OSError:
+        pass
+    return None
+
+
+class Usage(object):
+    """Resources, which are used by one or more commands: times and I/O are summed, peak RSS is the maximum.
+    I/O is measured in blocks of file system (512 bytes), so reads from page cache aren't counted.
+    limit_killed is set, if one of limited commands was killed by the job limits (it isn't a resource)."""
+    field_names = ["wall", "user", "sys", "max_rss", "maj_flt", "read_bytes", "write_bytes"]
+
+    def __init__(self):
+        self.wall = 0.0
+        self.user = 0.0
+        self.sys = 0.0
+        self.max_rss = 0  # KB
+        self.maj_flt = 0
+        self.read_bytes = 0
+        self.write_bytes = 0
+        self.limit_killed = False
+
+    def add_rusage(self, rusage, wall):
+        self.wall += wall
+        self.user += rusage.ru_utime
+        self.sys += rusage.ru_stime
+        self.max_rss = max(self.max_rss, rusage.ru_maxrss)
+        self.maj_flt += rusage.ru_majflt
+        self.read_bytes += rusage.ru_inblock * 512
+        self.write_bytes += rusage.ru_oublock * 512
+
+    def add(self, other):
+        for i in self.field_names:
+            if i == "max_rss":
+                self.max_rss = max(self.max_rss, other.max_rss)
+            else:
+                setattr(self, i, getattr(self, i) + getattr(other, i))
+        self.limit_killed = self.limit_killed or other.limit_killed
+
+    # Average usage of num runs (peak RSS is the same)
+    def get_average(self, num):
+        ret = Usage()
+        for i in self.field_names:
+            setattr(ret, i, getattr(self, i) if i == "max_rss" or num == 0 else getattr(self, i) / num)
+        return ret
+
+    def __str__(self):
+        return "wall: {:.2f} s | user: {:.2f} s | sys: {:.2f} s | peak rss: {:.1f} MB | major faults: {:g} | " \
+               "read: {:.1f} MB | written: {:.1f} MB".format(self.wall, self.user, self.sys, self.max_rss / 1024,
+                                                             self.maj_flt, self.read_bytes / 2 ** 20,
+                                                             self.write_bytes / 2 ** 20)
+
+    # Values for csv file (wall, user and sys are in seconds, peak RSS is in KB, I/O is in bytes)
+    def get_csv_values(self):
+        return ["{:.3f}".format(getattr(self, i)) if isinstance(getattr(self, i), float) else str(getattr(self, i))
+                for i in self.field_names]
+
+
+# Processes, which are started by the command (e.g. compiler under make), are in its process group, so they are
+# killed with it. Otherwise they keep output pipes open and hung compiler holds the caller after timeout.
+def kill_process_group(process):
+    try:
+        os.killpg(process.pid, signal.SIGKILL)
+    except ProcessLookupError:
+        pass
+
+
+# Writes input_data to stdin of the process and reads its output, until both output pipes are closed. If deadline
+# (time.monotonic) is reached, process group is killed and the rest of output is read. Returns output, err_output
+# and True, if the deadline was reached.
+def communicate_until(process, input_data, deadline):
+    poller = select.poll()
+    chunks = {process.stdout.fileno(): [], process.stderr.fileno(): []}
+    open_fds = set(chunks)
+    for i in chunks:
+        poller.register(i, select.POLLIN)
+    input_offset = 0
+    if process.stdin is not None:
+        if input_data:
+            poller.register(process.stdin.fileno(), select.POLLOUT)
+            open_fds.add(process.stdin.fileno())
+        else:
+            process.stdin.close()
     time_expired = False
-    start_time = os.times()
-    with subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE) as process:
-        try:
-            log_msg_str = "Running " + str(cmd)
-            if num != -1:
-                log_msg_str += " in process " + str(num)
-            log_msg(logging.DEBUG, log_msg_str)
-            output, err_output = process.communicate(timeout=time_out)
-            ret_code = process.poll()
-        except subprocess.TimeoutExpired:
-            process.kill()
-            log_msg(logging.DEBUG, str(cmd) + " failed")
-            output, err_output = process.communicate()
+    while len(open_fds) != 0:
+        time_out = None if deadline is None or time_expired else max(deadline - time.monotonic(), 0)
+        ready = poller.poll(None if time_out is None else time_out * 1000)
+        if len(ready) == 0 and time_out is not None and time.monotonic() >= deadline:
+            kill_process_group(process)
             time_expired = True
-            ret_code = None
-        except:
-            log_msg(logging.ERROR, str(cmd) + " failed: unknown exception")
-            process.kill()
-            process.wait()
-            raise
-    end_time = os.times()
-    elapsed_time = end_time.children_user - start_time.children_user + \
-                   end_time.children_system - start_time.children_system
-    return ret_code, output, err_output, time_expired, elapsed_time
+        for fd, events in ready:
+            if fd in chunks:
+                data = os.read(fd, 65536)
+                if len(data) != 0:
+                    chunks[fd].append(data)
+                    continue
+            else:
+                # Pipe can accept PIPE_BUF bytes without blocking, when it is ready for writing
+                try:
+                    input_offset += os.write(fd, input_data[input_offset:input_offset + select.PIPE_BUF])
+                    if input_offset < len(input_data):
+                        continue
+                except BrokenPipeError:
+                    pass
+                process.stdin.close()
+            poller.unregister(fd)
+            open_fds.remove(fd)
+    return b"".join(chunks[process.stdout.fileno()]), b"".join(chunks[process.stderr.fileno()]), time_expired
+
+
+# Process is reaped with wait4, which returns resource usage of the process (and its subprocesses). Unlike deltas
+# of os.times(), it isn't affected by other children, which are running at the same time. Process is killed, if it
+# doesn't exit before the deadline. Return code is set to process, so Popen doesn't wait for it again.
+# Returns resource usage and True, if the deadline was reached.
+def wait_process(process, deadline):
+    time_expired = False
+    while True:
+        pid, status, rusage = os.wait4(process.pid, 0 if deadline is None else os.WNOHANG)
+        if pid == process.pid:
+            break
+        if time.monotonic() >= deadline:
+            kill_process_group(process)
+            time_expired = True
+            deadline = None
+        else:
+            time.sleep(0.01)
+    process.returncode = -os.WTERMSIG(status) if os.WIFSIGNALED(status) else os.WEXITSTATUS(status)
+    return rusage, time_expired
+
+
+# input_data is passed to stdin of the command, pass_fds are inherited by it (e.g. memory files).
+# If limited is set, limits of set_job_limits are applied to the command. Command runs in its own session.
+# Returned elapsed_time is cpu time of the command. If usage is specified, all resources of the command are added to it
+# (and its limit_killed is set, if the command was killed by the limits).
+def run_cmd(cmd, time_out=None, num=-1, input_data=None, pass_fds=(), limited=False, usage=None):
+    start_wall_time = time.time()
+    deadline = time.monotonic() + time_out if time_out is not None else None
+    stdin = subprocess.PIPE if input_data is not None else None
+    cgroup_dir = create_job_cgroup() if limited and job_cgroup is not None else None
+    try:
+        process = subprocess.Popen(get_limited_cmd(cmd, cgroup_dir) if limited else cmd, stdin=stdin,
+                                   stdout=subprocess.PIPE, stderr=subprocess.PIPE, pass_fds=pass_fds,
+                                   start_new_session=True)
+    except:
+        if cgroup_dir is not None:
+            remove_job_cgroup(cgroup_dir)
+        raise
+    try:
+        log_msg_str = "Running " + str(cmd)
+        if num != -1:
+            log_msg_str += " in process " + str(num)
+        log_msg(logging.DEBUG, log_msg_str)
+        output, err_output, time_expired = communicate_until(process, input_data, deadline)
+        rusage, wait_expired = wait_process(process, None if time_expired else deadline)
+        time_expired = time_expired or wait_expired
+    except:
+        log_msg(logging.ERROR, str(cmd) + " failed: unknown exception")
+        kill_process_group(process)
+        if process.returncode is None:
+            wait_process(process, None)
+        raise
+    finally:
+        for i in [process.stdin, process.stdout, process.stderr]:
+            if i is not None:
+                i.close()
+        oom_kills = 0
+        if cgroup_dir is not None:
+            oom_kills = get_cgroup_oom_kills(cgroup_dir)
+            remove_job_cgroup(cgroup_dir)
+    ret_code = process.returncode
+    if time_expired:
+        log_msg(logging.DEBUG, str(cmd) + " failed")
+        ret_code = None
+    if usage is not None:
+        usage.add_rusage(rusage, time.time() - start_wall_time)
+        if limited and ret_code not in (None, 0) and is_killed_by_limit(ret_code, err_output, rusage, oom_kills):
+            usage.limit_killed = True
+    return ret_code, output, err_output, time_expired, rusage.ru_utime + rusage.ru_stime
+
+
+# Memory files (memfd) can be used instead of files on disk through /proc/self/fd/<fd> path, which stays valid
+# in child processes if fd is passed to them
+def create_mem_file(name):
+    return os.memfd_create(name)
+
+
+def get_mem_file_path(fd):
+    return "/proc/self/fd/" + str(fd)
+
+
+# Memory file can't be executed while it is open for writing, so it is replaced with read-only descriptor
+def reopen_mem_file_read_only(fd):
+    read_only_fd = os.open(get_mem_file_path(fd), os.O_RDONLY)
+    os.close(fd)
+    return read_only_fd
 
 
 def if_exec_exist(program):
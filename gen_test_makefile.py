@@ -67,6 +67,60 @@ executable = MakefileVariable("EXECUTABLE", "out")
 Makefile_variable_list.append(executable)
 # Makefile_variable_list.append(Makefile_variable("",""))
 
+# Optimization level of reference build. If it is set, only func is compiled with options of the target and other
+# files are compiled with common options of compiler and this level, so their objects can be shared by targets.
+reference_opt = None
+
+# Output profiles of yarpgen (-p option). "c" profile produces .c files, which should be compiled as C99.
+out_profile_list = ["cxx", "light", "c"]
+out_profile = "cxx"
+
+
+def get_src_ext():
+    return ".c" if out_profile == "c" else ".cpp"
+
+
+def set_out_profile(profile):
+    global out_profile
+    if profile not in out_profile_list:
+        common.print_and_exit("Unknown output profile: " + profile)
+    out_profile = profile
+    sources.value = " ".join([os.path.splitext(i)[0] + get_src_ext() for i in sources.value.split()])
+    cxx_flags.value = "-x c -std=c99" if out_profile == "c" else "-std=c++11"
+
+
+# Light profile doesn't affect Test_Makefile, so we need to distinguish only C tests
+def get_out_profile(file_names):
+    return "c" if "driver.c" in file_names else "cxx"
+
+
+def detect_out_profile(test_dir):
+    set_out_profile(get_out_profile(os.listdir(test_dir)))
+
+
+def set_reference_opt(opt):
+    global reference_opt
+    reference_opt = opt
+
+
+# Only func exercises optimizations of the target, other files of the test just call it and check results
+def is_target_specific(source):
+    return os.path.splitext(source)[0].split("_")[0] == "func"
+
+
+# Bundle of several tests (-b option of yarpgen) has one driver and hash, while other files of test <num>
+# have suffix _<num>
+def set_bundle_size(size):
+    if size == 1:
+        sources.value = "init driver func check hash"
+        headers.value = "init.h"
+    else:
+        sources.value = "driver hash"
+        for i in range(size):
+            sources.value += " init_{0} func_{0} check_{0}".format(i)
+        headers.value = " ".join(["init_" + str(i) + ".h" for i in range(size)])
+    sources.value = " ".join([i + get_src_ext() for i in sources.value.split()])
+
 ###############################################################################
 # Section for sde
 
@@ -140,6 +194,23 @@ class CompilerTarget (object):
         self.arch = arch
         CompilerTarget.all_targets.append(self)
 
+    @staticmethod
+    def get_target(name):
+        for i in CompilerTarget.all_targets:
+            if i.name == name:
+                return i
+        common.print_and_exit("Can't find target " + name)
+
+    # Compiler with options of the target (the same as in Test_Makefile). If source is specified, it is compiler
+    # with options for this source (see reference_opt).
+    def get_cmd(self, source=None):
+        if source is not None and reference_opt is not None and not is_target_specific(source):
+            return [self.specs.comp_name] + self.specs.common_args.split() + reference_opt.split()
+        cmd = [self.specs.comp_name] + self.args.split()
+        if self.arch.comp_name != "":
+            cmd.append(self.specs.arch_prefix + self.arch.comp_name)
+        return cmd
+
 
 ###############################################################################
 # Section for config parser
@@ -262,8 +333,10 @@ def gen_makefile(out_file_name, force, config_file, only_target=None, inject_bla
         output += "\n"
         if inject_blame_opt is not None:
             output += target.name + ": " + "BLAMEOPTS=" + inject_blame_opt + "\n"
+        if reference_opt is not None:
+            output += target.name + ": " + "REFFLAGS=" + target.specs.common_args + " " + reference_opt + "\n"
         output += target.name + ": " + "EXECUTABLE=" + target.name + "_" + executable.value + "\n"
-        output += target.name + ": " + "$(addprefix " + target.name + "_, $(SOURCES:.cpp=.o))\n"
+        output += target.name + ": " + "$(addprefix " + target.name + "_, $(SOURCES:" + get_src_ext() + "=.o))\n"
         output += "\t" + "$(COMPILER) $(LDFLAGS) $(OPTFLAGS) -o $(EXECUTABLE) $^\n\n" 
 
     # Force make to rebuild everything
@@ -273,7 +346,8 @@ def gen_makefile(out_file_name, force, config_file, only_target=None, inject_bla
     for source in sources.value.split():
         source_name = source.split(".")[0]
         output += "%" + source_name + ".o: " + source + " FORCE\n"
-        output += "\t" + "$(COMPILER) $(CXXFLAGS) $(OPTFLAGS) -o $@ -c $<"
+        opt_flags = "$(REFFLAGS)" if reference_opt is not None and not is_target_specific(source) else "$(OPTFLAGS)"
+        output += "\t" + "$(COMPILER) $(CXXFLAGS) " + opt_flags + " -o $@ -c $<"
         if inject_blame_opt is not None and source_name == "func":
             output += " $(BLAMEOPTS)"
         output += "\n\n"
@@ -323,10 +397,13 @@ if __name__ == '__main__':
                         help="Increase output verbosity")
     parser.add_argument("--log-file", dest="log_file", type=str,
                         help="Logfile")
+    parser.add_argument("-p", "--out-profile", dest="out_profile", default=out_profile, choices=out_profile_list,
+                        help="Output profile of yarpgen")
     args = parser.parse_args()
 
     log_level = logging.DEBUG if args.verbose else logging.INFO
     common.setup_logger(args.log_file, log_level)
 
     common.check_python_version()
+    set_out_profile(args.out_profile)
     gen_makefile(os.path.abspath(args.out_file), args.force, args.config_file)
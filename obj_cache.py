@@ -0,0 +1,250 @@
+#!/usr/bin/python3
+###############################################################################
+#
+# Copyright (c) 2015-2016, Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+###############################################################################
+"""
+Content-addressed cache of compiled objects, which is shared by all processes of run_gen.py, rechecker.py and
+blame_opt.py. Key of the object is a hash of compiler binary, compiler options and preprocessed source,
+so the same object is reused by tests and targets, which compile the same code in the same way.
+Objects are inserted with atomic rename, least recently used objects are evicted when size of cache exceeds its limit.
+"""
+###############################################################################
+
+import argparse
+import fcntl
+import hashlib
+import logging
+import os
+import shlex
+import shutil
+import sys
+
+import common
+
+# Cache is shared by all runs of the user, so it isn't kept in output or source dirs
+default_cache_dir = os.path.join(os.environ.get("XDG_CACHE_HOME", os.path.join(os.path.expanduser("~"), ".cache")),
+                                 "yarpgen", "obj_cache")
+default_max_size = 1024  # MB
+stat_file_name = "stats"
+stat_names = ["hits", "misses", "inserts", "evictions"]
+# Size of cache is checked after this number of inserts in every process
+sweep_period = 32
+
+# Cache, which is used by run_make. It is set by setup().
+cache = None
+
+###############################################################################
+
+
+class ObjCache(object):
+    def __init__(self, cache_dir, max_size):
+        self.cache_dir = os.path.abspath(cache_dir)
+        self.max_size = max_size * 1024 * 1024
+        self.compiler_ids = dict()
+        self.inserts = 0
+        common.check_dir_and_create(self.cache_dir)
+
+    # Compiler is identified by its binary and version, so the cache isn't invalidated by update of compiler
+    def get_compiler_id(self, compiler):
+        path = shutil.which(compiler)
+        if path is None:
+            return compiler
+        path = os.path.realpath(path)
+        path_stat = os.stat(path)
+        stat_key = (path, path_stat.st_mtime, path_stat.st_size)
+        if stat_key not in self.compiler_ids:
+            compiler_hash = hashlib.sha256()
+            with open(path, "rb") as compiler_file:
+                compiler_hash.update(compiler_file.read())
+            ret_code, output, err_output, time_expired, elapsed_time = common.run_cmd([compiler, "--version"], 60)
+            compiler_hash.update(output)
+            self.compiler_ids[stat_key] = compiler_hash.hexdigest()
+        return self.compiler_ids[stat_key]
+
+    # Command should compile one source ("-" for stdin) without output option. Returns None if the source can't be
+    # preprocessed (compiler will report the error). Self-contained input (it includes only system headers, which
+    # belong to compiler) can be hashed as is, without extra run of preprocessor. Resources of preprocessor are added
+    # to usage (common.Usage).
+    def get_key(self, cmd, source, input_data=None, num=-1, preprocess=True, usage=None):
+        options = [i for i in cmd[1:] if i != source]
+        output = input_data
+        if preprocess:
+            ret_code, output, err_output, time_expired, elapsed_time = \
+                common.run_cmd(cmd + ["-E", "-P", "-o", "-"], None, num, input_data, usage=usage)
+            if ret_code != 0:
+                return None
+        key = hashlib.sha256()
+        key.update(bytes("preprocessed" if preprocess else "raw", "utf-8"))
+        key.update(bytes(self.get_compiler_id(cmd[0]), "utf-8"))
+        # Options are hashed as given: value of option can be a separate token, so tokens can't be deduplicated
+        key.update(bytes("\0".join(options), "utf-8"))
+        key.update(hashlib.sha256(output).digest())
+        return key.hexdigest()
+
+    def get_obj_path(self, key):
+        return os.path.join(self.cache_dir, key[:2], key + ".o")
+
+    # Returns object or None. Object can be evicted by other process at any moment.
+    def get(self, key):
+        try:
+            with open(self.get_obj_path(key), "rb") as obj_file:
+                obj = obj_file.read()
+            os.utime(self.get_obj_path(key))
+            return obj
+        except FileNotFoundError:
+            return None
+
+    def put(self, key, obj):
+        obj_path = self.get_obj_path(key)
+        common.check_dir_and_create(os.path.dirname(obj_path))
+        tmp_path = obj_path + "." + str(os.getpid()) + ".tmp"
+        with open(tmp_path, "wb") as tmp_file:
+            tmp_file.write(obj)
+        os.rename(tmp_path, obj_path)
+        self.inserts += 1
+        if self.inserts % sweep_period == 0:
+            self.sweep()
+
+    # Removes least recently used objects, until the size of cache is 90% of its limit
+    def sweep(self):
+        objs = []
+        size = 0
+        for root, dirs, files in os.walk(self.cache_dir):
+            for name in files:
+                if not name.endswith(".o"):
+                    continue
+                try:
+                    obj_stat = os.stat(os.path.join(root, name))
+                except FileNotFoundError:
+                    continue
+                objs.append((obj_stat.st_mtime, obj_stat.st_size, os.path.join(root, name)))
+                size += obj_stat.st_size
+        if size <= self.max_size:
+            return
+        evictions = 0
+        for mtime, obj_size, path in sorted(objs):
+            if size <= self.max_size * 0.9:
+                break
+            try:
+                os.remove(path)
+                evictions += 1
+            except FileNotFoundError:
+                pass
+            size -= obj_size
+        self.update_stats({"evictions": evictions})
+
+    def update_stats(self, delta):
+        with open(os.path.join(self.cache_dir, stat_file_name), "a+") as stat_file:
+            fcntl.flock(stat_file, fcntl.LOCK_EX)
+            stat_file.seek(0)
+            stats = self.parse_stats(stat_file.read())
+            for i in delta:
+                stats[i] += delta[i]
+            stat_file.seek(0)
+            stat_file.truncate()
+            stat_file.write(" ".join([i + "=" + str(stats[i]) for i in stat_names]) + "\n")
+            # Buffered stats must reach the file while it is still locked
+            stat_file.flush()
+            fcntl.flock(stat_file, fcntl.LOCK_UN)
+
+    @staticmethod
+    def parse_stats(stat_str):
+        stats = {i: 0 for i in stat_names}
+        for i in stat_str.split():
+            name, value = i.split("=")
+            stats[name] = int(value)
+        return stats
+
+    def get_stats(self):
+        stat_path = os.path.join(self.cache_dir, stat_file_name)
+        if not os.path.isfile(stat_path):
+            return self.parse_stats("")
+        with open(stat_path, "r") as stat_file:
+            return self.parse_stats(stat_file.read())
+
+    def get_stats_str(self):
+        stats = self.get_stats()
+        lookups = stats["hits"] + stats["misses"]
+        hit_rate = 100.0 * stats["hits"] / lookups if lookups != 0 else 0.0
+        return "object cache: " + " | ".join([i + ": " + str(stats[i]) for i in stat_names]) + \
+               " | hit rate: " + "{:.1f}".format(hit_rate) + "%"
+
+    # Builds the target of makefile. Compile commands are taken from "make -n": objects, which are found in cache,
+    # are copied and make doesn't rebuild them (-o option), other objects are inserted after the build.
+    def make(self, makefile, target, time_out, num, limited=False, usage=None):
+        ret_code, output, err_output, time_expired, elapsed_time = \
+            common.run_cmd(["make", "-n", "-f", makefile, target], time_out, num, usage=usage)
+        make_args = []
+        misses = []
+        for line in str(output, "utf-8").split("\n"):
+            cmd = shlex.split(line)
+            if "-c" not in cmd or "-o" not in cmd or cmd.index("-o") + 1 >= len(cmd):
+                continue
+            obj_name = cmd[cmd.index("-o") + 1]
+            del cmd[cmd.index("-o"):cmd.index("-o") + 2]
+            source = cmd[cmd.index("-c") + 1] if cmd.index("-c") + 1 < len(cmd) else None
+            key = self.get_key(cmd, source, None, num, True, usage) if source is not None else None
+            if key is None:
+                continue
+            obj = self.get(key)
+            if obj is None:
+                misses.append((key, obj_name))
+                continue
+            with open(obj_name, "wb") as obj_file:
+                obj_file.write(obj)
+            make_args += ["-o", obj_name]
+        self.update_stats({"hits": len(make_args) // 2, "misses": len(misses)})
+
+        ret_code, output, err_output, time_expired, elapsed_time = \
+            common.run_cmd(["make", "-f", makefile, target] + make_args, time_out, num, limited=limited, usage=usage)
+        if ret_code == 0 and not time_expired:
+            for key, obj_name in misses:
+                with open(obj_name, "rb") as obj_file:
+                    self.put(key, obj_file.read())
+            self.update_stats({"inserts": len(misses)})
+        return ret_code, output, err_output, time_expired, elapsed_time
+
+
+def setup(cache_dir, max_size=default_max_size):
+    global cache
+    cache = ObjCache(cache_dir, max_size) if cache_dir is not None else None
+
+
+# Builds the target of makefile with cache (if it is set up). Build can be limited (see common.set_job_limits),
+# its resources are added to usage.
+def run_make(makefile, target, time_out, num, limited=False, usage=None):
+    if cache is None:
+        return common.run_cmd(["make", "-f", makefile, target], time_out, num, limited=limited, usage=usage)
+    return cache.make(makefile, target, time_out, num, limited, usage)
+
+###############################################################################
+
+if __name__ == '__main__':
+    description = "Prints statistics of object cache or clears it."
+    parser = argparse.ArgumentParser(description=description, formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("-d", "--cache-dir", dest="cache_dir", default=default_cache_dir, type=str,
+                        help="Directory of object cache")
+    parser.add_argument("--clear", dest="clear", default=False, action="store_true",
+                        help="Remove all objects and statistics")
+    args = parser.parse_args()
+
+    common.setup_logger(None, logging.INFO)
+    common.check_python_version()
+    if args.clear:
+        shutil.rmtree(args.cache_dir, ignore_errors=True)
+        sys.exit(0)
+    print(ObjCache(args.cache_dir, default_max_size).get_stats_str())
@@ -25,42 +25,79 @@ import argparse
 import logging
 import multiprocessing
 import os
+import shutil
 import sys
+import tempfile
 import queue
 
 import common
 import gen_test_makefile
+import obj_cache
+import result_index
+import result_store
 import run_gen
 import blame_opt
 
 
 ###############################################################################
 
-def process_dir(directory, task_queue):
+# Tests, which aren't in the index (e.g. they were copied to results by hand), are found by the search of S_* dirs
+def process_dir(directory, index):
     common.log_msg(logging.DEBUG, "Searching for test directories in " + str(directory))
     for root, dirs, files in os.walk(directory):
-        for name in dirs:
-            if name.startswith("S_"):
-                common.log_msg(logging.DEBUG, "Adding " + str(os.path.join(root, name)))
-                task_queue.put(os.path.join(root, name))
-            else:
-                process_dir(os.path.join(root, name), task_queue)
-    return task_queue
+        # Blobs of the result store aren't tests
+        if result_store.store_dir_name in dirs:
+            dirs.remove(result_store.store_dir_name)
+        for name in [i for i in dirs if i.startswith("S_")]:
+            common.log_msg(logging.DEBUG, "Adding " + str(os.path.join(root, name)))
+            index.add_test(os.path.join(root, name), name[len("S_"):])
+            dirs.remove(name)
 
 
-def prepare_env_and_recheck(input_dir, out_dir, target, num_jobs, config_file):
+# Only tests, which weren't checked with current versions of compilers and flags of targets, are rechecked
+# (all tests are rechecked if full is set). Tests, which have already failed with them, are only copied to out_dir.
+# Tests are queued in the order of their expected cost, so the longest tests don't remain at the end.
+def prepare_env_and_recheck(input_dir, out_dir, target, num_jobs, config_file, index_file, rescan, full):
     if not common.check_if_dir_exists(input_dir):
         common.print_and_exit("Can't use input directory")
     common.check_dir_and_create(out_dir)
 
-    run_gen.gen_test_makefile_and_copy(out_dir, config_file)
+    # Test_Makefile is generated for every test, because tests can have different output profiles
+    gen_test_makefile.parse_config(config_file)
     run_gen.dump_testing_sets(target)
     run_gen.print_compilers_version(target)
 
-    lock = multiprocessing.Lock()
+    if index_file is None:
+        index_file = result_index.find_index(input_dir)
+    if index_file is None:
+        index_file = os.path.join(input_dir, result_index.index_file_name)
+    common.log_msg(logging.DEBUG, "Using index " + index_file)
+    index = result_index.ResultIndex(index_file)
+    tests = index.get_tests(input_dir)
+    if rescan or len(tests) == 0:
+        process_dir(input_dir, index)
+        tests = index.get_tests(input_dir)
+
+    targets = [i for i in gen_test_makefile.CompilerTarget.all_targets if i.specs.name in target.split()]
+    costs = []
+    known_fails = 0
+    for test_dir in tests:
+        # Flags of checks depend on output profile of the test
+        gen_test_makefile.set_out_profile(gen_test_makefile.get_out_profile(result_store.list_files(test_dir)))
+        checks = [(i, index.get_check(test_dir, i) if not full else None) for i in targets]
+        unchecked = [i for i, check in checks if check is None]
+        if any(check is not None and check[0] != run_gen.ok for i, check in checks):
+            known_fails += 1
+            costs.append((0.0, test_dir))
+        elif len(unchecked) != 0:
+            costs.append((index.get_cost(test_dir, unchecked), test_dir))
+    index.close()
+    common.log_msg(logging.INFO, "Tests to recheck: " + str(len(costs) - known_fails) + " of " + str(len(tests)) +
+                   ", tests with known fails to copy: " + str(known_fails))
 
     task_queue = multiprocessing.JoinableQueue()
-    process_dir(input_dir, task_queue)
+    for cost, test_dir in sorted(costs, reverse=True):
+        task_queue.put(test_dir)
     failed_queue = multiprocessing.SimpleQueue()
     passed_queue = multiprocessing.SimpleQueue()
 
@@ -68,7 +105,8 @@ def prepare_env_and_recheck(input_dir, out_dir, target, num_jobs, config_file):
     for num in range(num_jobs):
         task_threads[num] = \
             multiprocessing.Process(target=recheck,
-                                    args=(num, lock, task_queue, failed_queue, passed_queue, target, out_dir))
+                                    args=(num, task_queue, failed_queue, passed_queue, target, input_dir, out_dir,
+                                          index_file, full))
         task_threads[num].start()
 
     task_queue.join()
@@ -78,63 +116,100 @@ def prepare_env_and_recheck(input_dir, out_dir, target, num_jobs, config_file):
         task_threads[num].join()
 
 
-def recheck(num, lock, task_queue, failed_queue, passed_queue, target, out_dir):
+# Checks of targets, which are found in the index, aren't repeated (their results are compared with other targets).
+# Failed tests are copied to the same relative path in out_dir, as they have in input_dir. Test, which has already
+# failed with current compilers and flags, is copied without rebuilding.
+def recheck(num, task_queue, failed_queue, passed_queue, target, input_dir, out_dir, index_file, full):
     common.log_msg(logging.DEBUG, "Started recheck. Process #" + str(num))
     cwd_save = os.getcwd()
     abs_out_dir = os.path.join(cwd_save, out_dir)
+    index = result_index.ResultIndex(index_file)
     job_finished = False
     while not job_finished:
         try:
             test_dir = task_queue.get_nowait()
             task_queue.task_done()
             common.log_msg(logging.DEBUG, "#" + str(num) + " test directory: " + str(test_dir))
-            abs_test_dir = os.path.join(cwd_save, test_dir)
-            common.check_and_copy(os.path.join(cwd_save, gen_test_makefile.Test_Makefile_name),
-                                  os.path.join(abs_test_dir, gen_test_makefile.Test_Makefile_name))
-            os.chdir(os.path.join(cwd_save, abs_test_dir))
+            abs_test_dir = test_dir
+            test_out_dir = os.path.join(abs_out_dir, os.path.relpath(test_dir, input_dir))
+            # Test from the result store is materialized in temporary dir, which is removed after the recheck
+            tmp_test_dir = None
+            if result_store.is_packed(abs_test_dir):
+                tmp_test_dir = tempfile.mkdtemp(prefix=common.tmp_dir_prefix, dir=abs_out_dir)
+                result_store.materialize(abs_test_dir, tmp_test_dir)
+                abs_test_dir = tmp_test_dir
+            # Saved Test_Makefile can have outdated options, so it is generated again for output profile of the test
+            gen_test_makefile.detect_out_profile(abs_test_dir)
+            gen_test_makefile.gen_makefile(os.path.join(abs_test_dir, gen_test_makefile.Test_Makefile_name), True,
+                                           None)
+            os.chdir(abs_test_dir)
+
+            targets = [i for i in gen_test_makefile.CompilerTarget.all_targets if i.specs.name in target.split()]
+            checks = {i.name: index.get_check(test_dir, i) if not full else None for i in targets}
+            if any(i is not None and i[0] != run_gen.ok for i in checks.values()):
+                common.log_msg(logging.DEBUG, "#" + str(num) + " Test has already failed")
+                failed_queue.put(test_dir)
+                common.copy_test_to_out(abs_test_dir, test_out_dir)
+                targets = []
 
-            valid_res = None
+            # Saved bundle prints checksum of every test
+            valid_res = run_gen.read_expected_checksum()
             out_res = set()
             prev_out_res_len = 1  # We can't check first result
-            for i in gen_test_makefile.CompilerTarget.all_targets:
-                if i.specs.name not in target.split():
-                    continue
-
-                common.log_msg(logging.DEBUG, "Re-checking target " + i.name)
-                ret_code, output, err_output, time_expired, elapsed_time = \
-                    common.run_cmd(["make", "-f", gen_test_makefile.Test_Makefile_name, i.name],
-                                   run_gen.compiler_timeout, num)
-                if time_expired or ret_code != 0:
-                    failed_queue.put(test_dir)
-                    common.log_msg(logging.DEBUG, "#" + str(num) + " Compilation failed")
-                    copy_test_to_out(abs_test_dir, os.path.join(abs_out_dir, test_dir), lock)
-                    break
+            if valid_res is not None:
+                out_res.add(tuple(valid_res))
+            for i in targets:
+                check = checks[i.name]
+                if check is not None:
+                    common.log_msg(logging.DEBUG, "Target " + i.name + " was checked with " + i.specs.version)
+                    res = check[1]
+                else:
+                    common.log_msg(logging.DEBUG, "Re-checking target " + i.name)
+                    ret_code, output, err_output, time_expired, compile_time = \
+                        obj_cache.run_make(gen_test_makefile.Test_Makefile_name, i.name, run_gen.compiler_timeout,
+                                           num)
+                    if time_expired or ret_code != 0:
+                        index.add_check(test_dir, i, run_gen.compfail_timeout if time_expired else run_gen.compfail,
+                                        None, compile_time, 0.0)
+                        failed_queue.put(test_dir)
+                        common.log_msg(logging.DEBUG, "#" + str(num) + " Compilation failed")
+                        common.copy_test_to_out(abs_test_dir, test_out_dir)
+                        break
 
-                ret_code, output, err_output, time_expired, elapsed_time = \
-                    common.run_cmd(["make", "-f", gen_test_makefile.Test_Makefile_name, "run_" + i.name],
-                                   run_gen.run_timeout, num)
-                if time_expired or ret_code != 0:
-                    failed_queue.put(test_dir)
-                    common.log_msg(logging.DEBUG, "#" + str(num) + " Execution failed")
-                    copy_test_to_out(abs_test_dir, os.path.join(abs_out_dir, test_dir), lock)
-                    break
+                    ret_code, output, err_output, time_expired, run_time = \
+                        common.run_cmd(["make", "-f", gen_test_makefile.Test_Makefile_name, "run_" + i.name],
+                                       run_gen.run_timeout, num)
+                    if time_expired or ret_code != 0:
+                        index.add_check(test_dir, i, run_gen.runfail_timeout if time_expired else run_gen.runfail,
+                                        None, compile_time, run_time)
+                        failed_queue.put(test_dir)
+                        common.log_msg(logging.DEBUG, "#" + str(num) + " Execution failed")
+                        common.copy_test_to_out(abs_test_dir, test_out_dir)
+                        break
 
-                out_res.add(str(output, "utf-8").split()[-1])
-                if len(out_res) > prev_out_res_len:
+                    res = str(output, "utf-8").split()[-len(valid_res) if valid_res is not None else -1:]
+                out_res.add(tuple(res))
+                failed = (valid_res is not None and res != valid_res) or len(out_res) > prev_out_res_len
+                if check is None:
+                    index.add_check(test_dir, i, run_gen.out_dif if failed else run_gen.ok, res, compile_time,
+                                    run_time)
+                if failed:
                     prev_out_res_len = len(out_res)
                     failed_queue.put(test_dir)
                     common.log_msg(logging.DEBUG, "#" + str(num) + " Out differs")
-                    if not blame_opt.prepare_env_and_blame(abs_test_dir, valid_res, i, abs_out_dir, lock, num):
-                        common.copy_test_to_out(abs_test_dir, os.path.join(abs_out_dir, test_dir), lock)
+                    if not blame_opt.prepare_env_and_blame(abs_test_dir, valid_res, i, abs_out_dir, num):
+                        common.copy_test_to_out(abs_test_dir, test_out_dir)
                     break
-                valid_res = str(output, "utf-8").split()[-1]
+                valid_res = res
 
             passed_queue.put(test_dir)
             os.chdir(cwd_save)
+            if tmp_test_dir is not None:
+                shutil.rmtree(tmp_test_dir)
 
         except queue.Empty:
             job_finished = True
-
+    index.close()
 
 ###############################################################################
 
@@ -162,10 +237,34 @@ if __name__ == '__main__':
                         help="Increase output verbosity")
     parser.add_argument("--log-file", dest="log_file", type=str,
                         help="Logfile")
+    parser.add_argument("--obj-cache-dir", dest="obj_cache_dir", default=obj_cache.default_cache_dir, type=str,
+                        help="Directory of object cache, which is shared with run_gen.py (see obj_cache.py)")
+    parser.add_argument("--obj-cache-size", dest="obj_cache_size", default=obj_cache.default_max_size, type=int,
+                        help="Size limit of object cache in MB")
+    parser.add_argument("--obj-cache", dest="use_obj_cache", default=False, action="store_true",
+                        help="Reuse compiled objects of the same sources and options (see obj_cache.py).")
+    parser.add_argument("--blame-jobs", dest="blame_jobs", default=blame_opt.blame_jobs, type=int,
+                        help="Number of optimization numbers, which are checked in parallel in every round of"
+                             " bisection of failed optimization (see blame_opt.py)")
+    parser.add_argument("--index-file", dest="index_file", default=None, type=str,
+                        help="Index of tests (see result_index.py). By default, the nearest " +
+                             result_index.index_file_name + " in input directory or its parents is used,"
+                             " or it is created in input directory.")
+    parser.add_argument("--rescan", dest="rescan", default=False, action="store_true",
+                        help="Search for tests in input directory, which aren't in the index yet")
+    parser.add_argument("--full", dest="full", default=False, action="store_true",
+                        help="Recheck all tests, even if they were checked with the same compilers and flags")
+    parser.add_argument("--reference-opt", dest="reference_opt", default=None, type=str,
+                        help="Optimization options of reference build, which were used by run_gen.py"
+                             " (see its --reference-opt)")
     args = parser.parse_args()
 
     log_level = logging.DEBUG if args.verbose else logging.INFO
     common.setup_logger(args.log_file, log_level)
 
     common.check_python_version()
-    prepare_env_and_recheck(args.input_dir, args.out_dir, args.target, args.num_jobs, args.config_file)
+    blame_opt.set_blame_jobs(args.blame_jobs)
+    gen_test_makefile.set_reference_opt(args.reference_opt)
+    obj_cache.setup(args.obj_cache_dir if args.use_obj_cache else None, args.obj_cache_size)
+    prepare_env_and_recheck(args.input_dir, args.out_dir, args.target, args.num_jobs, args.config_file,
+                            args.index_file, args.rescan, args.full)
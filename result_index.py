@@ -0,0 +1,158 @@
+#!/usr/bin/python3
+###############################################################################
+#
+# Copyright (c) 2015-2016, Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+###############################################################################
+"""
+Index of saved tests in SQLite database, which is kept in result dir. run_gen.py adds every saved test with outcomes
+of all its targets, rechecker.py adds outcomes of rechecks. Check of the test by the target is identified by version
+of compiler and its flags, so rechecker.py runs only checks, which weren't done yet, and estimates their cost
+by timings of previous checks. Checks are never replaced: repeated check is added to the history of the test, and
+the last one is its current outcome.
+"""
+###############################################################################
+
+import argparse
+import logging
+import os
+import sqlite3
+import time
+
+import common
+import gen_test_makefile
+
+index_file_name = "index.sqlite"
+# Waiting time for the lock of database, which is shared by all processes
+db_timeout = 60
+
+###############################################################################
+
+
+class ResultIndex(object):
+    def __init__(self, index_file):
+        self.index_dir = os.path.dirname(os.path.abspath(index_file))
+        self.avg_times = dict()
+        self.db = sqlite3.connect(index_file, timeout=db_timeout)
+        self.db.execute("PRAGMA journal_mode=WAL")
+        with self.db:
+            self.db.execute("CREATE TABLE IF NOT EXISTS tests (path TEXT PRIMARY KEY, seed TEXT, time REAL)")
+            # res is a checksum (or checksums of bundle), which is NULL if compilation or run has failed
+            self.db.execute("CREATE TABLE IF NOT EXISTS checks (path TEXT, target TEXT, compiler_version TEXT, "
+                            "flags TEXT, outcome TEXT, res TEXT, compile_time REAL, run_time REAL, time REAL)")
+            self.db.execute("CREATE INDEX IF NOT EXISTS checks_key ON checks "
+                            "(path, target, compiler_version, flags, time)")
+
+    # Tests are identified by path relative to the index, so result dir can be moved as a whole
+    def get_test_path(self, test_dir):
+        return os.path.relpath(os.path.abspath(test_dir), self.index_dir)
+
+    def add_test(self, test_dir, seed):
+        with self.db:
+            self.db.execute("INSERT OR IGNORE INTO tests VALUES (?, ?, ?)",
+                            (self.get_test_path(test_dir), seed, time.time()))
+
+    # Returns existing dirs of tests inside of the directory
+    def get_tests(self, directory):
+        prefix = self.get_test_path(directory)
+        ret = []
+        for path, in self.db.execute("SELECT path FROM tests ORDER BY path"):
+            test_dir = os.path.join(self.index_dir, path)
+            if (prefix == "." or path == prefix or path.startswith(prefix + os.sep)) and os.path.isdir(test_dir):
+                ret.append(test_dir)
+        return ret
+
+    # Flags of the target, flags of output profile (CXXFLAGS) of current test and flags of reference build
+    # (see gen_test_makefile.reference_opt)
+    @staticmethod
+    def get_flags(target):
+        flags = target.get_cmd() + gen_test_makefile.cxx_flags.value.split()
+        if gen_test_makefile.reference_opt is not None:
+            flags += ["REFFLAGS="] + target.get_cmd("init" + gen_test_makefile.get_src_ext())
+        return " ".join(flags)
+
+    def add_check(self, test_dir, target, outcome, res, compile_time, run_time):
+        with self.db:
+            self.db.execute("INSERT INTO checks VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                            (self.get_test_path(test_dir), target.name, target.specs.version,
+                             self.get_flags(target), outcome, " ".join(res) if res is not None else None,
+                             compile_time, run_time, time.time()))
+
+    # Returns (outcome, res) of the last check with current version of compiler and flags of the target or None
+    def get_check(self, test_dir, target):
+        row = self.db.execute("SELECT outcome, res FROM checks WHERE path = ? AND target = ? AND "
+                              "compiler_version = ? AND flags = ? ORDER BY time DESC LIMIT 1",
+                              (self.get_test_path(test_dir), target.name, target.specs.version,
+                               self.get_flags(target))).fetchone()
+        if row is None:
+            return None
+        return row[0], row[1].split() if row[1] is not None else None
+
+    # Expected time of checks of the test by targets. The last check of the target with any compiler is used,
+    # or average time of the target, if the test wasn't checked by it.
+    def get_cost(self, test_dir, targets):
+        cost = 0.0
+        for i in targets:
+            row = self.db.execute("SELECT compile_time + run_time FROM checks WHERE path = ? AND target = ? "
+                                  "ORDER BY time DESC LIMIT 1", (self.get_test_path(test_dir), i.name)).fetchone()
+            if row is None:
+                if i.name not in self.avg_times:
+                    self.avg_times[i.name] = self.db.execute("SELECT AVG(compile_time + run_time) FROM checks "
+                                                             "WHERE target = ?", (i.name,)).fetchone()
+                row = self.avg_times[i.name]
+            cost += row[0] if row[0] is not None else 0.0
+        return cost
+
+    # Only the last check of every test with the same compiler and flags is counted
+    def get_stats_str(self):
+        tests = self.db.execute("SELECT COUNT(*) FROM tests").fetchone()[0]
+        ret = "saved tests: " + str(tests) + "\n"
+        for row in self.db.execute("SELECT target, compiler_version, outcome, COUNT(*), AVG(compile_time), "
+                                   "AVG(run_time) FROM checks AS last WHERE time = (SELECT MAX(time) FROM checks "
+                                   "WHERE path = last.path AND target = last.target AND "
+                                   "compiler_version = last.compiler_version AND flags = last.flags) "
+                                   "GROUP BY target, compiler_version, outcome"):
+            ret += "\t" + row[0] + " | " + row[1] + " | " + row[2] + " : " + str(row[3]) + \
+                   " | compile: " + "{:.2f}".format(row[4]) + " s | run: " + "{:.2f}".format(row[5]) + " s\n"
+        return ret
+
+    def close(self):
+        self.db.close()
+
+
+# Index of tests in the directory is the nearest one in it or its parents (None if there is no such index)
+def find_index(directory):
+    directory = os.path.abspath(directory)
+    while True:
+        if os.path.isfile(os.path.join(directory, index_file_name)):
+            return os.path.join(directory, index_file_name)
+        if os.path.dirname(directory) == directory:
+            return None
+        directory = os.path.dirname(directory)
+
+###############################################################################
+
+if __name__ == '__main__':
+    description = "Prints outcomes of saved tests from index of result dir."
+    parser = argparse.ArgumentParser(description=description, formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("input_dir", type=str, help="Result dir or any of its subdirs")
+    args = parser.parse_args()
+
+    common.setup_logger(None, logging.INFO)
+    common.check_python_version()
+    index_file = find_index(args.input_dir)
+    if index_file is None:
+        common.print_and_exit("Can't find " + index_file_name + " in " + args.input_dir + " or its parents")
+    print(ResultIndex(index_file).get_stats_str(), end="")
@@ -0,0 +1,168 @@
+#!/usr/bin/python3
+###############################################################################
+#
+# Copyright (c) 2015-2016, Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+###############################################################################
+"""
+Content-addressed store of saved tests. Files of saved tests are kept in the store as compressed blobs, which are
+named by hash of their content, so files, which are shared by many tests (hash, driver, Test_Makefile, yarpgen binary
+or sources of the test, which has failed with several targets), are stored once. Dir of saved test keeps only its
+log.txt and manifest with hashes of its files. The script materializes saved tests (rechecker.py reads them directly).
+"""
+###############################################################################
+
+import argparse
+import gzip
+import hashlib
+import logging
+import os
+import shutil
+import stat
+
+import common
+
+store_dir_name = "store"
+manifest_file_name = "manifest.txt"
+# Files, which stay in dir of saved test
+kept_files = ["log.txt", manifest_file_name]
+
+###############################################################################
+
+
+def get_blob_path(store_dir, key):
+    return os.path.join(store_dir, key[:2], key + ".gz")
+
+
+# Blob is inserted with atomic rename, so the store is shared by all processes without locks. Returns its key.
+def put_blob(store_dir, data):
+    key = hashlib.sha256(data).hexdigest()
+    blob_path = get_blob_path(store_dir, key)
+    if not os.path.isfile(blob_path):
+        common.check_dir_and_create(os.path.dirname(blob_path))
+        tmp_path = blob_path + "." + str(os.getpid()) + ".tmp"
+        with open(tmp_path, "wb") as tmp_file:
+            tmp_file.write(gzip.compress(data, compresslevel=6))
+        os.rename(tmp_path, blob_path)
+    return key
+
+
+def get_blob(store_dir, key):
+    with open(get_blob_path(store_dir, key), "rb") as blob_file:
+        return gzip.decompress(blob_file.read())
+
+
+def is_packed(test_dir):
+    return os.path.isfile(os.path.join(test_dir, manifest_file_name))
+
+
+# Moves files of test dir to the store and writes manifest instead of them. The store is referenced by relative path,
+# so result dir can be moved as a whole. Test dir is expected to be at the same depth as its final destination.
+def pack_dir(test_dir, store_dir):
+    manifest = "store " + os.path.relpath(store_dir, test_dir) + "\n"
+    for name in sorted(os.listdir(test_dir)):
+        path = os.path.join(test_dir, name)
+        if name in kept_files or not os.path.isfile(path):
+            continue
+        with open(path, "rb") as test_file:
+            key = put_blob(store_dir, test_file.read())
+        manifest += key + " " + format(stat.S_IMODE(os.stat(path).st_mode), "o") + " " + name + "\n"
+        os.remove(path)
+    with open(os.path.join(test_dir, manifest_file_name), "w") as manifest_file:
+        manifest_file.write(manifest)
+
+
+# Returns path of the store and list of (key, mode, file name)
+def read_manifest(test_dir):
+    store_dir = None
+    files = []
+    with open(os.path.join(test_dir, manifest_file_name), "r") as manifest_file:
+        for line in manifest_file:
+            fields = line.rstrip("\n").split(" ", 2)
+            if fields[0] == "store":
+                store_dir = os.path.join(test_dir, " ".join(fields[1:]))
+            elif len(fields) == 3:
+                files.append((fields[0], int(fields[1], 8), fields[2]))
+    return store_dir, files
+
+
+# Returns names of files of the test (packed or not)
+def list_files(test_dir):
+    if not is_packed(test_dir):
+        return os.listdir(test_dir)
+    store_dir, files = read_manifest(test_dir)
+    return [name for key, mode, name in files] + [i for i in kept_files if os.path.isfile(os.path.join(test_dir, i))]
+
+
+# Writes all files of packed test to dest (log.txt is copied as is)
+def materialize(test_dir, dest):
+    store_dir, files = read_manifest(test_dir)
+    common.check_dir_and_create(dest)
+    for key, mode, name in files:
+        path = os.path.join(dest, name)
+        with open(path, "wb") as test_file:
+            test_file.write(get_blob(store_dir, key))
+        os.chmod(path, mode)
+    for name in kept_files:
+        if name != manifest_file_name and os.path.isfile(os.path.join(test_dir, name)):
+            shutil.copy(os.path.join(test_dir, name), dest)
+
+
+# Returns number of packed tests, size of their files and size of blobs in the store
+def get_stats(res_dir):
+    tests = 0
+    files_size = 0
+    blobs_size = 0
+    for root, dirs, files in os.walk(res_dir):
+        if manifest_file_name in files:
+            tests += 1
+            files_size += sum(os.path.getsize(os.path.join(root, i)) for i in kept_files if i in files)
+            store_dir, test_files = read_manifest(root)
+            for key, mode, name in test_files:
+                with open(get_blob_path(store_dir, key), "rb") as blob_file:
+                    blob_file.seek(-4, os.SEEK_END)
+                    # Size of uncompressed data is the last field of gzip
+                    files_size += int.from_bytes(blob_file.read(4), "little")
+        elif os.path.basename(root) == store_dir_name:
+            for sub_root, sub_dirs, blobs in os.walk(root):
+                blobs_size += sum(os.path.getsize(os.path.join(sub_root, i)) for i in blobs)
+            dirs[:] = []
+    return tests, files_size, blobs_size
+
+###############################################################################
+
+if __name__ == '__main__':
+    description = "Materializes saved tests from the result store or prints its statistics."
+    parser = argparse.ArgumentParser(description=description, formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument("input_dir", type=str,
+                        help="Dir of saved test or any dir with saved tests (e.g. result dir of run_gen.py)")
+    parser.add_argument("-o", "--output-dir", dest="out_dir", default="materialized", type=str,
+                        help="Output directory, tests are placed at the same relative paths as in input dir")
+    parser.add_argument("--stats", dest="stats", default=False, action="store_true",
+                        help="Print size of saved tests and size of the store instead of materializing")
+    args = parser.parse_args()
+
+    common.setup_logger(None, logging.INFO)
+    common.check_python_version()
+    if not common.check_if_dir_exists(args.input_dir):
+        common.print_and_exit("Can't use input directory")
+    if args.stats:
+        tests, files_size, blobs_size = get_stats(args.input_dir)
+        print("saved tests: " + str(tests) + " | size of files: " + str(files_size // 1024) + " KB" +
+              " | size of store: " + str(blobs_size // 1024) + " KB")
+    else:
+        for root, dirs, files in os.walk(args.input_dir):
+            if manifest_file_name in files:
+                materialize(root, os.path.join(args.out_dir, os.path.relpath(root, args.input_dir)))
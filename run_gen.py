@@ -23,23 +23,96 @@ Script for autonomous testing with YARP Generator
 
 import argparse
 import datetime
+import hashlib
+import io
 import logging
+import math
 import multiprocessing
-import multiprocessing.managers
 import os
+import pickle
+import queue
+import re
 import shutil
+import subprocess
 import sys
+import tarfile
 import time
 
 import common
 import gen_test_makefile
+import obj_cache
+import result_index
+import result_store
 
 res_dir = "result"
-process_dir = "process_"
+# Files of saved tests are moved to the store in res_dir (see result_store.py)
+use_result_store = False
+# Every yarpgen binary, which is saved with failed tests, is stored once in this dir of res_dir (name is its hash),
+# if the result store isn't used
+yarpgen_store_dir = "yarpgen_bin"
+yarpgen_hash = None
+# Result of every target is written to this file in test dir (with name of the target), so the process, which has
+# finished the last target of the test, checks it. Check of the test is claimed by creation of check_marker.
+target_res_prefix = ".target_res_"
+check_marker = ".checked"
+# Every test is generated in its own dir, which is removed after all targets of the test are checked
+test_dir_prefix = "test_"
+# Makefile is shared by all tests
+test_makefile = ".." + os.sep + gen_test_makefile.Test_Makefile_name
+# Tests are generated by separate processes ahead of time (see generate_tests)
+gen_jobs = 1
+# Limit of generated, but not checked tests per process, which compiles and runs them
+max_tests_per_job = 4
+# Weight of the last measurement in average times of pipeline stages
+stage_time_weight = 0.2
+# Delay of generator, when the queue of ready tasks is full
+gen_poll_delay = 0.1
+# New job is started only if 1-minute load average is below this value (None means no limit)
+max_load = None
+# Delay of the job, which isn't admitted due to lack of resources
+admission_delay = 0.5
+# Resources of every phase of every test are written to this file in output dir (see common.Usage)
+usage_log_file_name = "usage.csv"
+# yarpgen writes checksum, which is expected from every correct target, to this file
+expected_checksum_file_name = "expected_checksum.txt"
+# Binary IR of the test, which can be re-emitted or reduced with "yarpgen -l"
+ir_file_name = "test.ir"
+# Number of mutants (-m option of yarpgen) and members of family (-f option) of every test. Every variant is checked
+# as a separate test, which differs from its base test only in func and expected checksum.
+mutant_num = 0
+family_size = 0
+# Variant can't be re-generated by seed alone, so command, which emits it, is saved with it
+variant_file_name = "variant.txt"
+# Number of tests, which are linked in one executable (-b option of yarpgen)
+bundle_size = 1
+# Every process uses its own "yarpgen server" instead of exec of yarpgen for every test
+use_gen_server = False
+# In zero-disk mode test is streamed from yarpgen (-o option), sources are passed to compilers through stdin and
+# objects and executables are memory files. Test is written to disk only if it is saved.
+zero_disk = False
 
 yarpgen_timeout = 60
 compiler_timeout = 600
 run_timeout = 300 
+# Timeouts of compilation and run of the target are learned from observed durations of the phase for tests of the
+# same size class (see Statistics): it is hang_factor times timeout_quantile of them, but not less than min_timeout
+# and not more than the fixed timeout. Phase, which has finished, but took more than slow_factor times the quantile
+# (and more than min_slow_time), is a slow outlier. Slow compilation is saved as possible performance bug.
+adaptive_timeouts = False
+timeout_quantile = 0.95
+hang_factor = 10
+slow_factor = 3
+min_timeout = 30
+min_slow_time = 5
+# Number of observed durations, which is required to use adaptive timeout
+min_time_samples = 20
+# Size class of the test is log4 of size of its sources in units of size_class_unit (up to size_class_num - 1)
+size_class_unit = 16 * 1024
+size_class_num = 6
+# Durations are counted in log-scale bins: bin i starts at time_bin_base * time_bin_ratio ** i
+time_bin_base = 0.01
+time_bin_ratio = 2 ** 0.25
+time_bin_num = 72
 stat_update_delay = 10
 
 script_start_time = datetime.datetime.now()  # We should init variable, so let's do it this way
@@ -47,120 +120,159 @@ script_start_time = datetime.datetime.now()  # We should init variable, so let's
 ###############################################################################
 
 
-class MyManager(multiprocessing.managers.BaseManager):
-    pass
-
-
-def manager():
-    m = MyManager()
-    m.start()
-    return m 
-
-
 total = "total"
 ok = "ok"
 runfail = "runfail"
 runfail_timeout = "runfail_timeout"
 compfail = "compfail"
 compfail_timeout = "compfail_timeout"
+# Compiler was killed by limits of the job (see common.set_job_limits)
+compfail_limit = "compfail_limit"
 out_dif = "different_output"
+# Slow outliers of phases (see slow_factor)
+compile_slow = "compile_slow"
+run_slow = "run_slow"
 
-
-class CmdRun (object):
-
-    def __init__(self, name):
-        self.name = name
-        self.total = 0
-        self.ok = 0
-        self.compfail = 0
-        self.compfail_timeout = 0
-        self.runfail = 0
-        self.runfail_timeout = 0
-        self.out_dif = 0
-        self.duration = datetime.timedelta(0)
-
-    def update(self, tag):
-        self.total += 1
-        global ok
-        if tag == ok:
-            self.ok += 1
-        global runfail
-        if tag == runfail:
-            self.runfail += 1
-        global runfail_timeout
-        if tag == runfail_timeout:
-            self.runfail_timeout += 1
-        global compfail
-        if tag == compfail:
-            self.compfail += 1
-        global compfail_timeout
-        if tag == compfail_timeout:
-            self.compfail_timeout += 1
-        global out_dif
-        if tag == out_dif:
-            self.out_dif += 1
-
-    def get_value(self, tag):
-        if tag == total:
-            return self.total
-        if tag == ok:
-            return self.ok
-        if tag == runfail:
-            return self.runfail
-        if tag == runfail_timeout:
-            return self.runfail_timeout
-        if tag == compfail:
-            return self.compfail
-        if tag == compfail_timeout:
-            return self.compfail_timeout
-        if tag == out_dif:
-            return self.out_dif
-
-    def update_duration(self, interval):
-        self.duration += interval
-
-    def get_duration(self):
-        return self.duration
-
-    def get_name(self):
-        return self.name
+# Phases of testing of the target, which are measured separately
+gen_phase = "generate"
+compile_phase = "compile"
+run_phase = "run"
+target_phases = [compile_phase, run_phase]
+slow_tags = {compile_phase: compile_slow, run_phase: run_slow}
 
 
 class Statistics (object):
-    def __init__(self):
-        self.yarpgen_runs = CmdRun("yarpgen")
-        self.target_runs = {} 
-        # TODO: we create objects for every target, but we can choose less in arguments
+    """Statistics in shared memory. Every process writes only to its own slot (see set_writer), so updates don't
+    need locks or IPC, and values are summed over all slots on read.
+    Slot consists of record of yarpgen and records of targets. Record of the run has counters of every tag and
+    duration, usage of every phase is stored as values of common.Usage fields. Record of the target also has
+    histograms of durations of its phases for every size class of tests (see time_bin_num)."""
+    tags = [total, ok, runfail, runfail_timeout, compfail, compfail_timeout, compfail_limit, out_dif, compile_slow,
+            run_slow]
+    run_record_size = len(tags) + 1
+    usage_record_size = len(common.Usage.field_names)
+    time_record_size = size_class_num * time_bin_num
+
+    def __init__(self, writer_num):
+        # TODO: we create records for every target, but we can choose less in arguments
+        self.target_offsets = {}
+        offset = self.run_record_size + self.usage_record_size
         for i in gen_test_makefile.CompilerTarget.all_targets:
-            self.target_runs[i.name] = CmdRun(i.name)
+            self.target_offsets[i.name] = offset
+            offset += self.run_record_size + len(target_phases) * (self.usage_record_size + self.time_record_size)
+        self.slot_size = offset
+        self.writer_num = writer_num
+        self.data = multiprocessing.RawArray("d", writer_num * self.slot_size)
+        self.writer = None
+
+    # Should be called by every process, which updates statistics, with its unique number
+    def set_writer(self, writer):
+        self.writer = writer
+
+    def update_run(self, offset, tag):
+        base = self.writer * self.slot_size + offset
+        self.data[base + self.tags.index(total)] += 1
+        if tag in self.tags and tag != total:
+            self.data[base + self.tags.index(tag)] += 1
+
+    def update_duration(self, offset, interval):
+        self.data[self.writer * self.slot_size + offset + len(self.tags)] += interval.total_seconds()
+
+    def update_usage(self, offset, usage):
+        base = self.writer * self.slot_size + offset
+        for i, field in enumerate(common.Usage.field_names):
+            if field == "max_rss":
+                self.data[base + i] = max(self.data[base + i], usage.max_rss)
+            else:
+                self.data[base + i] += getattr(usage, field)
+
+    def get_sum(self, offset):
+        return sum(self.data[i * self.slot_size + offset] for i in range(self.writer_num))
+
+    def get_run(self, offset, tag):
+        return int(self.get_sum(offset + self.tags.index(tag)))
+
+    def get_duration(self, offset):
+        return datetime.timedelta(seconds=self.get_sum(offset + len(self.tags)))
+
+    def get_usage(self, offset):
+        usage = common.Usage()
+        for i, field in enumerate(common.Usage.field_names):
+            if field == "max_rss":
+                usage.max_rss = int(max(self.data[j * self.slot_size + offset + i] for j in range(self.writer_num)))
+            else:
+                setattr(usage, field, self.get_sum(offset + i))
+        return usage
+
+    def get_phase_offset(self, target_name, phase):
+        return self.target_offsets[target_name] + self.run_record_size + \
+            target_phases.index(phase) * self.usage_record_size
 
     def update_yarpgen_runs(self, tag):
-        self.yarpgen_runs.update(tag)
+        self.update_run(0, tag)
 
     def get_yarpgen_runs(self, tag):
-        return self.yarpgen_runs.get_value(tag)
+        return self.get_run(0, tag)
 
     def update_yarpgen_duration(self, interval):
-        self.yarpgen_runs.update_duration(interval)
+        self.update_duration(0, interval)
 
     def get_yarpgen_duration(self):
-        return self.yarpgen_runs.get_duration()
+        return self.get_duration(0)
+
+    def update_yarpgen_usage(self, usage):
+        self.update_usage(self.run_record_size, usage)
+
+    def get_yarpgen_usage(self):
+        return self.get_usage(self.run_record_size)
 
     def update_target_runs(self, target_name, tag):
         if tag != ok:
             common.log_msg(logging.DEBUG, "Run of " + target_name + " has failed (" + tag + ")")
-        self.target_runs[target_name].update(tag)
+        self.update_run(self.target_offsets[target_name], tag)
 
     def get_target_runs(self, target_name, tag):
-        return self.target_runs[target_name].get_value(tag)
+        return self.get_run(self.target_offsets[target_name], tag)
 
     def update_target_duration(self, target_name, interval):
-        self.target_runs[target_name].update_duration(interval)
+        self.update_duration(self.target_offsets[target_name], interval)
 
     def get_target_duration(self, target_name):
-        return self.target_runs[target_name].get_duration()
-
-MyManager.register("Statistics", Statistics)
+        return self.get_duration(self.target_offsets[target_name])
+
+    def update_target_usage(self, target_name, phase, usage):
+        self.update_usage(self.get_phase_offset(target_name, phase), usage)
+
+    def get_target_usage(self, target_name, phase):
+        return self.get_usage(self.get_phase_offset(target_name, phase))
+
+    # Slow outlier isn't a separate run, so it doesn't change total
+    def update_target_slow(self, target_name, phase):
+        self.data[self.writer * self.slot_size + self.target_offsets[target_name] +
+                  self.tags.index(slow_tags[phase])] += 1
+
+    def get_time_offset(self, target_name, phase, size_class):
+        return self.target_offsets[target_name] + self.run_record_size + \
+            len(target_phases) * self.usage_record_size + \
+            target_phases.index(phase) * self.time_record_size + size_class * time_bin_num
+
+    def update_target_time(self, target_name, phase, size_class, duration):
+        time_bin = int(math.log(duration / time_bin_base, time_bin_ratio)) if duration > time_bin_base else 0
+        self.data[self.writer * self.slot_size + self.get_time_offset(target_name, phase, size_class) +
+                  min(time_bin, time_bin_num - 1)] += 1
+
+    # Returns the end of the bin, which has the quantile of durations of the size class, or None if there are too few
+    # durations.
+    def get_target_time_quantile(self, target_name, phase, size_class, quantile):
+        offset = self.get_time_offset(target_name, phase, size_class)
+        counts = [self.get_sum(offset + i) for i in range(time_bin_num)]
+        if sum(counts) < min_time_samples:
+            return None
+        count = 0
+        for i in range(time_bin_num):
+            count += counts[i]
+            if count >= quantile * sum(counts):
+                return time_bin_base * time_bin_ratio ** (i + 1)
 
 
 def strfdelta(time_delta, format_str):
@@ -178,7 +290,8 @@ def get_testing_speed(seed_num, time_delta):
 def form_statistics(stat, target, prev_len):
     verbose_stat_str = ""
 
-    testing_speed = get_testing_speed(stat.get_yarpgen_runs(total), datetime.datetime.now() - script_start_time)
+    testing_speed = get_testing_speed(stat.get_yarpgen_runs(total) * bundle_size,
+                                      datetime.datetime.now() - script_start_time)
 
     # TODO: make this section smaller
     verbose_stat_str += "\n##########################\n"
@@ -187,6 +300,8 @@ def form_statistics(stat, target, prev_len):
     verbose_stat_str += "duration: " + strfdelta(datetime.datetime.now() - script_start_time,
                                                  "{days} d {hours}:{minutes}:{seconds}") + "\n"
     verbose_stat_str += "testing speed: " + testing_speed + "\n"
+    if obj_cache.cache is not None:
+        verbose_stat_str += obj_cache.cache.get_stats_str() + "\n"
     verbose_stat_str += "\n##########################\n"
     verbose_stat_str += "generator stat:" + "\n"
     verbose_stat_str += "cpu time: " + strfdelta(stat.get_yarpgen_duration(),
@@ -195,6 +310,7 @@ def form_statistics(stat, target, prev_len):
     verbose_stat_str += "\t" + ok + " : " + str(stat.get_yarpgen_runs(ok)) + "\n"
     verbose_stat_str += "\t" + runfail_timeout + " : " + str(stat.get_yarpgen_runs(runfail_timeout)) + "\n"
     verbose_stat_str += "\t" + runfail + " : " + str(stat.get_yarpgen_runs(runfail)) + "\n"
+    verbose_stat_str += "\tper test: " + str(stat.get_yarpgen_usage().get_average(stat.get_yarpgen_runs(total))) + "\n"
 
     total_cpu_duration = stat.get_yarpgen_duration()
     total_gen_errors = stat.get_yarpgen_runs(runfail_timeout)
@@ -204,6 +320,7 @@ def form_statistics(stat, target, prev_len):
     total_runfail_timeout = 0
     total_runfail = 0
     total_compfail_timeout = 0
+    total_compfail_limit = 0
     total_compfail = 0
     total_out_dif = 0
 
@@ -220,6 +337,8 @@ def form_statistics(stat, target, prev_len):
         verbose_stat_str += "\t" + ok + " : " + str(stat.get_target_runs(i.name, ok)) + "\n"
         verbose_stat_str += "\t" + compfail_timeout + " : " + str(stat.get_target_runs(i.name, compfail_timeout)) + "\n"
         total_compfail_timeout += stat.get_target_runs(i.name, compfail_timeout)
+        verbose_stat_str += "\t" + compfail_limit + " : " + str(stat.get_target_runs(i.name, compfail_limit)) + "\n"
+        total_compfail_limit += stat.get_target_runs(i.name, compfail_limit)
         verbose_stat_str += "\t" + compfail + " : " + str(stat.get_target_runs(i.name, compfail)) + "\n"
         total_compfail += stat.get_target_runs(i.name, compfail)
         total_ok += stat.get_target_runs(i.name, ok)
@@ -229,6 +348,18 @@ def form_statistics(stat, target, prev_len):
         total_runfail += stat.get_target_runs(i.name, runfail)
         verbose_stat_str += "\t" + out_dif + " : " + str(stat.get_target_runs(i.name, out_dif)) + "\n"
         total_out_dif += stat.get_target_runs(i.name, out_dif)
+        for phase in target_phases:
+            verbose_stat_str += "\t" + slow_tags[phase] + " : " + \
+                str(stat.get_target_runs(i.name, slow_tags[phase])) + "\n"
+        for phase in target_phases:
+            verbose_stat_str += "\t" + phase + " per test: " + \
+                str(stat.get_target_usage(i.name, phase).get_average(stat.get_target_runs(i.name, total))) + "\n"
+        for phase in target_phases if adaptive_timeouts else []:
+            timeouts = [str(j) + ": " + "{:.1f}".format(get_phase_limits(stat, i.name, phase, j)[0]) + " s"
+                        for j in range(size_class_num)
+                        if stat.get_target_time_quantile(i.name, phase, j, timeout_quantile) is not None]
+            if len(timeouts) != 0:
+                verbose_stat_str += "\t" + phase + " timeout by size class: " + " | ".join(timeouts) + "\n"
 
     stat_str = '\r'
     stat_str += "time " + strfdelta(datetime.datetime.now() - script_start_time,
@@ -238,6 +369,7 @@ def form_statistics(stat, target, prev_len):
     stat_str += "target runs: " + str(total_runs) + " | "
     stat_str += "Errors: " + str(total_gen_errors) + "/"
     stat_str += str(total_compfail_timeout) + "/"
+    stat_str += str(total_compfail_limit) + "/"
     stat_str += str(total_compfail) + "/"
     stat_str += str(total_runfail_timeout) + "/"
     stat_str += str(total_runfail) + "/"
@@ -250,22 +382,151 @@ def form_statistics(stat, target, prev_len):
     return stat_str, verbose_stat_str, prev_len
 
 
-def print_online_statistics(lock, stat, target, task_threads, num_jobs):
-    any_alive = True
+def print_online_statistics(lock, stat, target, prev_len):
+    lock.acquire()
+    stat_str, verbose_stat_str, prev_len = form_statistics(stat, target, prev_len)
+    common.stat_logger.log(logging.INFO, verbose_stat_str)
+    sys.stdout.write(stat_str)
+    sys.stdout.flush()
+    lock.release()
+    return prev_len
+
+
+class UsageLog(object):
+    """CSV file with resources of every phase of every test"""
+    def __init__(self, file_name):
+        write_header = not os.path.isfile(file_name)
+        self.log_file = open(file_name, "a")
+        if write_header:
+            self.log_file.write(",".join(["seed", "target", "phase"] + common.Usage.field_names) + "\n")
+
+    def write_row(self, seed, target_name, phase, usage):
+        self.log_file.write(",".join([seed, target_name, phase] + usage.get_csv_values()) + "\n")
+
+    def close(self):
+        self.log_file.close()
+
+
+# Compares results of all targets of the test (target name -> result of test_target). Targets are checked in the
+# order of the config file, so the first different result is reported in the same way, regardless of the order,
+# in which targets have finished. Returns usage of phases of targets (target name, phase, usage) and saved tests,
+# which are added to the index with outcomes of all targets by collect_results: (dest, seed, list of (target name,
+# outcome, checksums, compile time, run time)).
+def check_test(num, stat, test_dir, seed, expected_res, target_names, target_res):
+    usage_rows = []
+    out_res = [set() for j in range(bundle_size)]
+    prev_out_res_len = [1] * bundle_size  # We can't check first result
+    if expected_res is not None:
+        for j in range(bundle_size):
+            out_res[j].add(expected_res[j])
+    # (dest, number of test in bundle or None, if the whole bundle is saved) and numbers of tests with wrong result
+    saved_tests = set()
+    failed_tests = dict()
+    for i in gen_test_makefile.CompilerTarget.all_targets:
+        if i.name not in target_names:
+            continue
+        fail_tag, res, output, err_output, usage, slow_phases = target_res[i.name]
+        for phase in target_phases:
+            stat.update_target_usage(i.name, phase, usage[phase])
+            usage_rows.append((i.name, phase, usage[phase]))
+        os.chdir(test_dir)
+        if compile_phase in slow_phases:
+            saved_tests.add((save_test(num, seed, output, err_output, i, compile_slow, usage=usage), None))
+        if fail_tag is not None:
+            stat.update_target_runs(i.name, fail_tag)
+            saved_tests.add((save_test(num, seed, output, err_output, i, fail_tag, usage=usage), None))
+            os.chdir("..")
+            continue
+        failed_tests[i.name] = set()
+        for j in range(bundle_size):
+            out_res[j].add(res[j])
+            if (expected_res is not None and res[j] != expected_res[j]) or \
+               len(out_res[j]) > prev_out_res_len[j]:
+                prev_out_res_len[j] = len(out_res[j])
+                failed_tests[i.name].add(j)
+                saved_tests.add((save_test(num, seed, output, err_output, i, "output", j, usage),
+                                 j if bundle_size > 1 else None))
+        os.chdir("..")
+        stat.update_target_runs(i.name, out_dif if len(failed_tests[i.name]) != 0 else ok)
+
+    saved = []
+    for dest, bundle_idx in saved_tests:
+        checks = []
+        for i in gen_test_makefile.CompilerTarget.all_targets:
+            if i.name not in target_names:
+                continue
+            fail_tag, res, output, err_output, usage, slow_phases = target_res[i.name]
+            if fail_tag is None:
+                failed = len(failed_tests[i.name]) != 0 if bundle_idx is None else bundle_idx in failed_tests[i.name]
+                fail_tag = out_dif if failed else ok
+                res = res if bundle_idx is None else [res[bundle_idx]]
+            checks.append((i.name, fail_tag, res, usage[compile_phase].wall, usage[run_phase].wall))
+        saved.append((dest, str(int(seed) + bundle_idx) if bundle_idx is not None else seed, checks))
+    return usage_rows, saved
+
+
+# Result of the target is written to the test dir. Every process writes its result before it looks for results of
+# other targets, so the process, which has finished the last target, always sees all of them. It checks the test
+# (and saves it, if it is needed), so saving of tests is spread over processes. If several processes see all
+# results, only one of them claims the check. Returns results of check_test or None, if the test isn't checked.
+def finish_target(num, stat, task, res):
+    test_dir, seed, target_name, files, expected_res, target_names = task
+    res_file = test_dir + os.sep + target_res_prefix + target_name
+    with open(res_file + ".tmp", "wb") as res_file_obj:
+        pickle.dump(res, res_file_obj)
+    os.rename(res_file + ".tmp", res_file)
+    if any(not os.path.isfile(test_dir + os.sep + target_res_prefix + i) for i in target_names):
+        return None
+    try:
+        os.close(os.open(test_dir + os.sep + check_marker, os.O_WRONLY | os.O_CREAT | os.O_EXCL))
+    except FileExistsError:
+        return None
+    target_res = dict()
+    for i in target_names:
+        with open(test_dir + os.sep + target_res_prefix + i, "rb") as res_file_obj:
+            target_res[i] = pickle.load(res_file_obj)
+    return check_test(num, stat, test_dir, seed, expected_res, target_names, target_res)
+
+
+# Gathers resources of generated tests and results of checked tests (see finish_target) from processes, writes them
+# to usage log and index, and prints statistics. Test dir is removed after the check and new test can be generated
+# instead of it. When all generators are finished, processes, which compile and run tests, are stopped after the
+# last task.
+def collect_results(lock, stat, target, gen_threads, task_threads, tasks, results, test_slots):
+    last_stat_time = 0
     prev_len = 0
-    while any_alive:
-        lock.acquire()
-        stat_str, verbose_stat_str, prev_len = form_statistics(stat, target, prev_len)
-        common.stat_logger.log(logging.INFO, verbose_stat_str)
-        sys.stdout.write(stat_str)
-        sys.stdout.flush()
-        lock.release()
-
-        any_alive = False
-        for num in range(num_jobs):
-            any_alive |= task_threads[num].is_alive()
-
-        time.sleep(stat_update_delay)
+    tasks_finished = False
+    usage_log = UsageLog(usage_log_file_name)
+    index = result_index.ResultIndex(res_dir + os.sep + result_index.index_file_name)
+    while any(i.is_alive() for i in task_threads) or not results.empty():
+        if not tasks_finished and not any(i.is_alive() for i in gen_threads):
+            for i in task_threads:
+                tasks.put(None)
+            tasks_finished = True
+        if time.time() - last_stat_time >= stat_update_delay:
+            prev_len = print_online_statistics(lock, stat, target, prev_len)
+            last_stat_time = time.time()
+        try:
+            msg = results.get(timeout=1)
+        except queue.Empty:
+            continue
+        if msg[0] == "test":
+            seed, gen_usage = msg[1:]
+            usage_log.write_row(seed, "yarpgen", gen_phase, gen_usage)
+            continue
+        test_dir, seed, usage_rows, saved = msg[1:]
+        for target_name, phase, usage in usage_rows:
+            usage_log.write_row(seed, target_name, phase, usage)
+        for dest, test_seed, checks in saved:
+            index.add_test(dest, test_seed)
+            for target_name, outcome, res, compile_time, run_time in checks:
+                index.add_check(dest, gen_test_makefile.CompilerTarget.get_target(target_name), outcome, res,
+                                compile_time, run_time)
+        shutil.rmtree(test_dir, ignore_errors=True)
+        test_slots.release()
+    usage_log.close()
+    index.close()
+    print_online_statistics(lock, stat, target, prev_len)
 
 
 def gen_test_makefile_and_copy(dest, config_file):
@@ -299,6 +560,9 @@ def prepare_env_and_start_testing(out_dir, timeout, target, num_jobs, config_fil
     # Check for binary of generator
     yarpgen_bin = os.path.abspath(common.yarpgen_home + os.sep + "yarpgen")
     common.check_and_copy(yarpgen_bin, out_dir)
+    global yarpgen_hash
+    with open(yarpgen_bin, "rb") as yarpgen_file:
+        yarpgen_hash = hashlib.sha256(yarpgen_file.read()).hexdigest()
     ret_code, output, err_output, time_expired, elapsed_time = common.run_cmd([yarpgen_bin, "-v"], yarpgen_timeout, 0)
     common.yarpgen_version = output
     # TODO: need to add some check, but I hope that it is safe
@@ -312,151 +576,571 @@ def prepare_env_and_start_testing(out_dir, timeout, target, num_jobs, config_fil
 
     os.chdir(out_dir)
     common.check_dir_and_create(res_dir)
-    for i in range(num_jobs):
-        common.check_dir_and_create(process_dir + str(i))
-        common.check_and_copy(test_makefile_location, process_dir + str(i))
 
     lock = multiprocessing.Lock()
-    manager_obj = manager()
-    stat = manager_obj.Statistics()
+    # Every generator, every process, which compiles and runs tests, and collect_results write their own statistics
+    stat = Statistics(gen_jobs + num_jobs + 1)
+    stat.set_writer(gen_jobs + num_jobs)
+    tasks = multiprocessing.Queue()
+    results = multiprocessing.Queue()
+    # Number of tests, which are generated, but not checked yet
+    test_slots = multiprocessing.Semaphore(max_tests_per_job * num_jobs)
+    # Average time of the task, which is used to tune the depth of the pipeline
+    task_time = multiprocessing.Value("d", 0.0)
+    # Number of jobs, which are admitted by admit_job
+    running_jobs = multiprocessing.Value("i", 0)
+    job_rss = multiprocessing.Value("i", 0)
 
     start_time = time.time()
     end_time = start_time + timeout * 60
     if timeout == -1:
         end_time = -1
 
+    gen_threads = [0] * gen_jobs
+    for num in range(gen_jobs):
+        gen_threads[num] = multiprocessing.Process(target=generate_tests,
+                                                   args=(num, end_time, stat, target, num_jobs, tasks,
+                                                         results, test_slots, task_time))
+        gen_threads[num].start()
+
     task_threads = [0] * num_jobs
     for num in range(num_jobs):
-        task_threads[num] = multiprocessing.Process(target=gen_and_test, args=(num, lock, end_time, stat, target))
+        task_threads[num] = multiprocessing.Process(target=process_tasks,
+                                                    args=(num, stat, tasks, results, task_time, running_jobs, job_rss))
         task_threads[num].start()
 
-    print_online_statistics(lock, stat, target, task_threads, num_jobs)
+    collect_results(lock, stat, target, gen_threads, task_threads, tasks, results, test_slots)
 
     sys.stdout.write("\n")
-    for i in range(num_jobs):
-        common.log_msg(logging.DEBUG, "Removing " + process_dir + str(i) + " dir")
-        shutil.rmtree(process_dir + str(i))
+    for i in os.listdir("."):
+        if i.startswith(test_dir_prefix):
+            common.log_msg(logging.DEBUG, "Removing " + i + " dir")
+            shutil.rmtree(i)
 
     stat_str, verbose_stat_str, prev_len = form_statistics(stat, target, 0)
     sys.stdout.write(verbose_stat_str)
     sys.stdout.flush()
 
 
-def gen_and_test(num, lock, end_time, stat, target):
-    common.log_msg(logging.DEBUG, "Job #" + str(num))
-    os.chdir(process_dir + str(num))
-    inf = (end_time == -1)
-
-    while inf or end_time > time.time():
-        # TODO: maybe, it is better to call generator through Makefile?
-        yarpgen_run_list = [".." + os.sep + "yarpgen", "-q"]
+def read_expected_checksum(files=None):
+    if files is not None:
+        if expected_checksum_file_name not in files:
+            return None
+        return str(files[expected_checksum_file_name], "utf-8").split()
+    if not os.path.isfile(expected_checksum_file_name):
+        return None
+    with open(expected_checksum_file_name, "r") as expected_file:
+        return expected_file.read().split()
+
+
+class GenServer(object):
+    """yarpgen in server mode. It forks pre-initialized process for every request, so exec and startup are skipped."""
+    def __init__(self, num):
+        self.num = num
+        self.process = None
+
+    def start(self):
+        common.log_msg(logging.DEBUG, "Starting yarpgen server in process " + str(self.num))
+        self.process = subprocess.Popen(["." + os.sep + "yarpgen", "server", "-t", str(yarpgen_timeout)],
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+    def stop(self):
+        if self.process is not None:
+            self.process.stdin.close()
+            self.process.wait()
+            self.process = None
+
+    # Returns the same values as common.run_cmd and seed of the test (None, if generator hasn't printed it).
+    # Server reports only cpu time of the request, so only it and wall time are added to usage.
+    def run(self, args, usage=None):
+        start_time = time.time()
+        if self.process is None or self.process.poll() is not None:
+            self.start()
+        try:
+            self.process.stdin.write((" ".join(args) + "\n").encode("utf-8"))
+            self.process.stdin.flush()
+            reply = self.process.stdout.readline().split()
+        except BrokenPipeError:
+            reply = []
+        # Server can die only due to bug in it, so it is reported as generator's fail and restarted
+        if len(reply) < 5:
+            common.log_msg(logging.WARNING, "yarpgen server has died in process " + str(self.num))
+            self.process.kill()
+            self.process.wait()
+            self.process = None
+            return -1, b"", b"", False, 0.0, None
+        status, seed, cpu_time, output_len, err_output_len = reply[:5]
+        output = self.process.stdout.read(int(output_len))
+        err_output = self.process.stdout.read(int(err_output_len))
+        common.log_msg(logging.DEBUG, "yarpgen server has created " + str(reply[5:]) + " in process " + str(self.num))
+        time_expired = status == b"timeout"
+        ret_code = None if time_expired else 0 if status == b"ok" else 1
+        if usage is not None:
+            usage.wall += time.time() - start_time
+            usage.user += int(cpu_time) / 1000
+        return ret_code, output, err_output, time_expired, int(cpu_time) / 1000, \
+            str(seed, "utf-8") if seed != b"-" else None
+
+
+# Returns seed from the message of generator ("/*SEED <seed>*/") or None
+def read_seed(gen_msg):
+    match = re.search(rb"/\*SEED (\S+)\*/", gen_msg)
+    return str(match.group(1), "utf-8") if match is not None else None
+
+
+# Returns files from the output of "yarpgen -o"
+def read_stream_output(output):
+    files = dict()
+    with tarfile.open(fileobj=io.BytesIO(output), mode="r|") as archive:
+        for member in archive:
+            files[member.name] = archive.extractfile(member).read()
+    return files
+
+
+# Sources are compiled from stdin, so compiler can't find local headers and they are inlined
+def inline_headers(source, files):
+    lines = []
+    for line in source.split(b"\n"):
+        match = re.match(rb'#include "(.*)"', line)
+        if match is not None and str(match.group(1), "utf-8") in files:
+            line = files[str(match.group(1), "utf-8")]
+        lines.append(line)
+    return b"\n".join(lines)
+
+
+# Compiles every source from stdin to memory file and links them to executable memory file.
+# Returns results of the last command (like common.run_cmd) and read-only fd of executable (or None).
+def build_in_memory(target, files, time_out, num, usage=None):
+    lang_flags = [] if "-x" in gen_test_makefile.cxx_flags.value.split() else ["-x", "c++"]
+    cache = obj_cache.cache
+    obj_fds = []
+    elapsed_time = 0.0
+    exe_fd = None
+    try:
+        for source in gen_test_makefile.sources.value.split():
+            obj_fds.append(common.create_mem_file(source))
+            cmd = target.get_cmd(source) + lang_flags + gen_test_makefile.cxx_flags.value.split() + ["-c", "-"]
+            input_data = inline_headers(files[source], files)
+            # Headers of the test are inlined, so the input can be hashed without preprocessing
+            key = cache.get_key(cmd, "-", input_data, num, False, usage) if cache is not None else None
+            if key is not None:
+                obj = cache.get(key)
+                cache.update_stats({"hits" if obj is not None else "misses": 1})
+                if obj is not None:
+                    os.write(obj_fds[-1], obj)
+                    continue
+            ret_code, output, err_output, time_expired, cmd_time = \
+                common.run_cmd(cmd + ["-o", common.get_mem_file_path(obj_fds[-1])], time_out, num,
+                               input_data, (obj_fds[-1],), True, usage)
+            elapsed_time += cmd_time
+            if time_expired or ret_code != 0:
+                return ret_code, output, err_output, time_expired, elapsed_time, None
+            if key is not None:
+                cache.put(key, os.pread(obj_fds[-1], os.fstat(obj_fds[-1]).st_size, 0))
+                cache.update_stats({"inserts": 1})
+        exe_fd = common.create_mem_file(target.name + "_" + gen_test_makefile.executable.value)
+        cmd = target.get_cmd() + gen_test_makefile.ld_flags.value.split() + \
+            ["-o", common.get_mem_file_path(exe_fd)] + [common.get_mem_file_path(i) for i in obj_fds]
+        ret_code, output, err_output, time_expired, cmd_time = \
+            common.run_cmd(cmd, time_out, num, None, tuple(obj_fds + [exe_fd]), True, usage)
+        elapsed_time += cmd_time
+        if time_expired or ret_code != 0:
+            os.close(exe_fd)
+            return ret_code, output, err_output, time_expired, elapsed_time, None
+        exe_fd = common.reopen_mem_file_read_only(exe_fd)
+        return ret_code, output, err_output, time_expired, elapsed_time, exe_fd
+    finally:
+        for i in obj_fds:
+            os.close(i)
+
+
+def run_in_memory(target, exe_fd, native_arch, time_out, num, usage=None):
+    cmd = [common.get_mem_file_path(exe_fd)]
+    required_sde_arch = gen_test_makefile.define_sde_arch(native_arch, target.arch.sde_arch)
+    if required_sde_arch != "":
+        cmd = ["sde", "-" + required_sde_arch, "--"] + cmd
+    try:
+        # It is reported as runfail, like missing sde in Test_Makefile
+        if not common.if_exec_exist(cmd[0]):
+            return 127, b"", bytes(cmd[0] + ": No such file or directory\n", "utf-8"), False, 0.0
+        return common.run_cmd(cmd, time_out, num, None, (exe_fd,), usage=usage)
+    finally:
+        os.close(exe_fd)
+
+
+# Writes files of the test, which are required to save it, to its dir: IR of the test (it is much bigger than
+# sources, so it is written only for saved tests) and all files in zero-disk mode. Tests with targets are saved only
+# by the process, which has claimed the check (see finish_target), so it is never called concurrently for the same
+# test. Variants are saved without IR.
+def materialize_test(seed, num):
+    if os.path.isfile(variant_file_name):
+        return
+    yarpgen_run_list = [".." + os.sep + "yarpgen", "-q", "-s", seed, "-p", gen_test_makefile.out_profile]
+    if bundle_size > 1:
+        if not zero_disk or os.path.isfile(expected_checksum_file_name):
+            return
+        yarpgen_run_list += ["-b", str(bundle_size)]
+    else:
+        if os.path.isfile(ir_file_name):
+            return
+        yarpgen_run_list += ["-w", ir_file_name]
+        # Sources of the test are already on disk, so they are streamed to stdout and dropped
+        if not zero_disk:
+            yarpgen_run_list.append("-o")
+    ret_code, output, err_output, time_expired, elapsed_time = common.run_cmd(yarpgen_run_list, yarpgen_timeout, num)
+    if ret_code != 0 or time_expired:
+        common.log_msg(logging.WARNING, "Can't write test with seed " + seed + " to disk")
+
+
+# Variants are emitted to subdirs of the test. Every variant is moved next to the test and gets links to other files
+# of the test, so it can be checked and saved as a separate test. Returns list of (dir, seed) of variants.
+def split_variants(test_dir, seed):
+    variants = []
+    yarpgen_cmd = "yarpgen -s " + seed + " -p " + gen_test_makefile.out_profile
+    if mutant_num > 0:
+        yarpgen_cmd += " -m " + str(mutant_num)
+    if family_size > 0:
+        yarpgen_cmd += " -f " + str(family_size)
+    for name in ["mutant_" + str(i) for i in range(mutant_num)] + ["family_" + str(i) for i in range(family_size)]:
+        variant_dir = test_dir + "_" + name
+        # yarpgen skips mutants, which it can't form
+        if not os.path.isdir(test_dir + os.sep + name):
+            continue
+        os.rename(test_dir + os.sep + name, variant_dir)
+        for j in gen_test_makefile.sources.value.split() + gen_test_makefile.headers.value.split():
+            if not os.path.isfile(variant_dir + os.sep + j):
+                common.link_or_copy(test_dir + os.sep + j, variant_dir)
+        with open(variant_dir + os.sep + variant_file_name, "w") as variant_file:
+            variant_file.write(yarpgen_cmd + " emits it to " + name + "\n")
+        variants.append((variant_dir, seed + "_" + name))
+    return variants
+
+
+# Generates the test in its own dir and returns list of (dir, seed, expected checksum, task for every target) for
+# the test and its variants (or None if generator has failed) and resources of generator
+def generate_test(num, stat, target, test_dir, gen_server):
+    os.mkdir(test_dir)
+    usage = common.Usage()
+    # TODO: maybe, it is better to call generator through Makefile?
+    yarpgen_args = ["-q", "-p", gen_test_makefile.out_profile, "-d", test_dir]
+    # IR is written only if the test is saved (see materialize_test)
+    if bundle_size > 1:
+        yarpgen_args += ["-b", str(bundle_size)]
+    if mutant_num > 0:
+        yarpgen_args += ["-m", str(mutant_num)]
+    if family_size > 0:
+        yarpgen_args += ["-f", str(family_size)]
+    if zero_disk:
+        yarpgen_args.append("-o")
+    # Streamed test is written to stdout, so seed is printed to stderr
+    if gen_server is not None:
+        ret_code, output, err_output, time_expired, elapsed_time, seed = gen_server.run(yarpgen_args, usage)
+    else:
         ret_code, output, err_output, time_expired, elapsed_time = \
-            common.run_cmd(yarpgen_run_list, yarpgen_timeout, num)
-        seed = str(output, "utf-8").split()[1][:-2] if len(output) else \
-            str(num) + "_" + datetime.datetime.now().strftime('%Y_%m_%d_%H_%M_%S')
+            common.run_cmd(["." + os.sep + "yarpgen"] + yarpgen_args, yarpgen_timeout, num, usage=usage)
+        seed = read_seed(err_output if zero_disk else output)
+    stat.update_yarpgen_usage(usage)
+    gen_msg = err_output if zero_disk else output
+    if seed is None:
+        seed = str(num) + "_" + datetime.datetime.now().strftime('%Y_%m_%d_%H_%M_%S')
+    common.log_msg(logging.DEBUG, "From process #" + str(num) + ": " + str(gen_msg, "utf-8", "replace"))
+    if time_expired or ret_code != 0:
+        fail_tag = runfail_timeout if time_expired else runfail
+        common.log_msg(logging.WARNING, "Generator has failed (" + fail_tag + ")")
+        stat.update_yarpgen_runs(fail_tag)
+        os.chdir(test_dir)
+        save_test(num, seed, output, err_output, None, fail_tag, usage={gen_phase: usage})
+        os.chdir("..")
+        shutil.rmtree(test_dir)
+        return seed, None, usage
+    stat.update_yarpgen_runs(ok)
+    stat.update_yarpgen_duration(datetime.timedelta(seconds=elapsed_time))
+    # Every target is compared with expected checksum, so reference target (ubsan) is optional.
+    # Without it we can only compare targets with each other.
+    files = read_stream_output(output) if zero_disk else None
+    tests = []
+    for variant_dir, variant_seed in [(test_dir, seed)] + split_variants(test_dir, seed):
+        os.chdir(variant_dir)
+        expected_res = read_expected_checksum(files)
+        os.chdir("..")
+        target_names = [i.name for i in gen_test_makefile.CompilerTarget.all_targets if i.specs.name in target.split()]
+        target_tasks = [(variant_dir, variant_seed, i, files, expected_res, target_names) for i in target_names]
+        tests.append((variant_dir, variant_seed, expected_res, target_tasks))
+    return seed, tests, usage
+
+
+# Size class of the test (see size_class_unit). Test is in the current dir, if its files aren't in memory.
+def get_size_class(files):
+    sources = gen_test_makefile.sources.value.split()
+    size = sum(len(files[i]) for i in sources) if files is not None else sum(os.path.getsize(i) for i in sources)
+    size_class = int(math.log(size / size_class_unit, 4)) if size > size_class_unit else 0
+    return min(size_class, size_class_num - 1)
+
+
+# Returns timeout of the phase and duration of its slow outlier (None, if there are too few observed durations).
+# Fixed timeout is used, until there are enough durations for the size class of the test: durations of smaller
+# tests would kill large tests as hangs.
+def get_phase_limits(stat, target_name, phase, size_class):
+    fixed_timeout = compiler_timeout if phase == compile_phase else run_timeout
+    quantile = None
+    if adaptive_timeouts:
+        quantile = stat.get_target_time_quantile(target_name, phase, size_class, timeout_quantile)
+    if quantile is None:
+        return fixed_timeout, None
+    return min(max(hang_factor * quantile, min_timeout), fixed_timeout), max(slow_factor * quantile, min_slow_time)
+
+
+# Adds wall time of the finished phase to statistics (timeouts are wall time). Returns True if it is a slow outlier.
+def update_phase_time(stat, target_name, phase, size_class, duration, slow_time):
+    stat.update_target_time(target_name, phase, size_class, duration)
+    if slow_time is None or duration <= slow_time:
+        return False
+    common.log_msg(logging.DEBUG, "Slow " + phase + " of " + target_name + ": " + "{:.2f}".format(duration) + " s")
+    stat.update_target_slow(target_name, phase)
+    return True
+
+
+# Compiles and runs the test with one target. Returns fail tag (None if the target hasn't failed), checksums, output,
+# err_output, resources of every phase and phases, which are slow outliers. Failed target is saved by finish_target,
+# because the test can be saved with other targets. Phase, which exceeds its timeout, is a hang.
+def test_target(num, stat, native_arch, task):
+    test_dir, seed, target_name, files, expected_res, target_names = task
+    i = gen_test_makefile.CompilerTarget.get_target(target_name)
+    usage = {j: common.Usage() for j in target_phases}
+    slow_phases = []
+    os.chdir(test_dir)
+    try:
+        size_class = get_size_class(files)
+        time_out, slow_time = get_phase_limits(stat, i.name, compile_phase, size_class)
+        if zero_disk:
+            ret_code, output, err_output, time_expired, elapsed_time, exe_fd = \
+                build_in_memory(i, files, time_out, num, usage[compile_phase])
+        else:
+            ret_code, output, err_output, time_expired, elapsed_time = \
+                obj_cache.run_make(test_makefile, i.name, time_out, num, True, usage[compile_phase])
+        target_elapsed_time = elapsed_time
         if time_expired:
-            common.log_msg(logging.WARNING, "Generator has failed (" + runfail_timeout + ")")
-            stat.update_yarpgen_runs(runfail_timeout)
-            save_test(lock, num, seed, output, err_output, None, runfail_timeout)
-            continue
+            return compfail_timeout, None, output, err_output, usage, slow_phases
         if ret_code != 0:
-            common.log_msg(logging.WARNING, "Generator has failed (" + runfail + ")")
-            stat.update_yarpgen_runs(runfail)
-            save_test(lock, num, seed, output, err_output, None, runfail)
-            continue
-        stat.update_yarpgen_runs(ok)
-        stat.update_yarpgen_duration(datetime.timedelta(seconds=elapsed_time))
-        out_res = set()
-        prev_out_res_len = 1  # We can't check first result
-        for i in gen_test_makefile.CompilerTarget.all_targets:
-            if i.specs.name not in target.split():
-                continue
-            target_elapsed_time = 0.0
-            common.log_msg(logging.DEBUG, "From process #" + str(num) + ": " + str(output, "utf-8"))
+            return compfail_limit if usage[compile_phase].limit_killed else compfail, None, \
+                output, err_output, usage, slow_phases
+        if update_phase_time(stat, i.name, compile_phase, size_class, usage[compile_phase].wall, slow_time):
+            slow_phases.append(compile_phase)
 
+        time_out, slow_time = get_phase_limits(stat, i.name, run_phase, size_class)
+        if zero_disk:
             ret_code, output, err_output, time_expired, elapsed_time = \
-                common.run_cmd(["make", "-f", gen_test_makefile.Test_Makefile_name, i.name], compiler_timeout, num)
-            target_elapsed_time += elapsed_time
-            if time_expired:
-                stat.update_target_runs(i.name, compfail_timeout)
-                save_test(lock, num, seed, output, err_output, i, compfail_timeout)
-                continue
-            if ret_code != 0:
-                stat.update_target_runs(i.name, compfail)
-                save_test(lock, num, seed, output, err_output, i, compfail)
-                continue
-
+                run_in_memory(i, exe_fd, native_arch, time_out, num, usage[run_phase])
+        else:
             ret_code, output, err_output, time_expired, elapsed_time = \
-                common.run_cmd(["make", "-f", gen_test_makefile.Test_Makefile_name, "run_" + i.name], run_timeout, num)
-            target_elapsed_time += elapsed_time
-            if time_expired:
-                stat.update_target_runs(i.name, runfail_timeout)
-                save_test(lock, num, seed, output, err_output, i, runfail_timeout)
-                continue
-            if ret_code != 0:
-                stat.update_target_runs(i.name, runfail)
-                save_test(lock, num, seed, output, err_output, i, runfail)
-                continue
-
-            stat.update_target_duration(i.name, datetime.timedelta(seconds=target_elapsed_time))
-
-            out_res.add(str(output, "utf-8").split()[-1])
-            if len(out_res) > prev_out_res_len:
-                prev_out_res_len = len(out_res)
-                stat.update_target_runs(i.name, out_dif)
-                save_test(lock, num, seed, output, err_output, i, "output")
-            else:
-                stat.update_target_runs(i.name, ok)
-
+                common.run_cmd(["make", "-f", test_makefile, "run_" + i.name], time_out, num,
+                               usage=usage[run_phase])
+        target_elapsed_time += elapsed_time
+        # Test in bundle can crash, so it is detected by the number of printed checksums
+        res = str(output, "utf-8").split()[-bundle_size:] if not time_expired and ret_code == 0 else []
+        if time_expired or len(res) != bundle_size:
+            return runfail_timeout if time_expired else runfail, None, output, err_output, usage, slow_phases
+        if update_phase_time(stat, i.name, run_phase, size_class, usage[run_phase].wall, slow_time):
+            slow_phases.append(run_phase)
+
+        stat.update_target_duration(i.name, datetime.timedelta(seconds=target_elapsed_time))
+        return None, res, output, err_output, usage, slow_phases
+    finally:
+        os.chdir("..")
+
+
+def update_stage_time(avg_time, stage_time):
+    return stage_time if avg_time == 0.0 else (1 - stage_time_weight) * avg_time + stage_time_weight * stage_time
+
+
+# Generator is the first stage of the pipeline: it puts tasks of new tests to the queue, while compilation of
+# previous tests is running. Depth of the queue is tuned from measured times of stages: it should hold tasks for
+# all processes during generation of the next test, so they never wait for it.
+def generate_tests(num, end_time, stat, target, num_jobs, tasks, results, test_slots, task_time):
+    common.log_msg(logging.DEBUG, "Generator #" + str(num))
+    stat.set_writer(num)
+    inf = (end_time == -1)
+    gen_server = GenServer(num) if use_gen_server else None
+    gen_time = 0.0
+    test_num = 0
 
-def save_test(lock, num, seed, output, err_output, target, fail_tag):
+    while inf or end_time > time.time():
+        depth = num_jobs
+        if task_time.value != 0.0:
+            depth += int(math.ceil(num_jobs * gen_time / task_time.value))
+        if tasks.qsize() >= depth:
+            time.sleep(gen_poll_delay)
+            continue
+        if not test_slots.acquire(timeout=1):
+            continue
+        test_dir = test_dir_prefix + str(num) + "_" + str(test_num)
+        test_num += 1
+        start_time = time.time()
+        seed, tests, usage = generate_test(num, stat, target, test_dir, gen_server)
+        gen_time = update_stage_time(gen_time, time.time() - start_time)
+        if tests is None:
+            test_slots.release()
+            continue
+        for i, (test_dir, seed, expected_res, target_tasks) in enumerate(tests):
+            # Slot of the first test is already taken, variants wait for their slots after it is queued
+            if i != 0:
+                test_slots.acquire()
+            results.put(("test", seed, usage))
+            for j in target_tasks:
+                tasks.put(j)
+
+    if gen_server is not None:
+        gen_server.stop()
+
+
+# Memory of the job is the peak RSS of compilations, which is measured so far (job_rss, MB). The limit is used
+# before the first measurement.
+def resources_available(job_rss):
+    if max_load is not None and os.getloadavg()[0] >= max_load:
+        return False
+    if common.job_mem_limit is None:
+        return True
+    available_mem = common.get_mem_info("MemAvailable")
+    job_mem = job_rss.value if job_rss.value != 0 else common.job_mem_limit
+    return available_mem is None or available_mem >= job_mem
+
+
+# Job is started only if there is enough memory for it (if memory limit is set) and load is below max_load.
+# If no other jobs are running, it is started anyway, so testing never stops.
+def admit_job(running_jobs, job_rss):
+    while True:
+        with running_jobs.get_lock():
+            if running_jobs.value == 0 or resources_available(job_rss):
+                running_jobs.value += 1
+                return
+        time.sleep(admission_delay)
+
+
+# Every process takes compilation and run of the test with one target from the common queue, so all processes
+# work on targets of the same tests, instead of waiting for the slowest target of their own test.
+# None in the queue means that all tests are generated.
+def process_tasks(num, stat, tasks, results, task_time, running_jobs, job_rss):
+    common.log_msg(logging.DEBUG, "Job #" + str(num))
+    stat.set_writer(gen_jobs + num)
+    native_arch = gen_test_makefile.detect_native_arch() if zero_disk else None
+
+    while True:
+        task = tasks.get()
+        if task is None:
+            break
+        admit_job(running_jobs, job_rss)
+        start_time = time.time()
+        res = test_target(num, stat, native_arch, task)
+        with running_jobs.get_lock():
+            running_jobs.value -= 1
+        # ru_maxrss is in KB
+        compile_rss = res[4][compile_phase].max_rss // 1024
+        with job_rss.get_lock():
+            job_rss.value = max(job_rss.value, compile_rss)
+        checked = finish_target(num, stat, task, res)
+        if checked is not None:
+            results.put(("checked", task[0], task[1]) + checked)
+        with task_time.get_lock():
+            task_time.value = update_stage_time(task_time.value, time.time() - start_time)
+
+
+# Test with wrong result is saved alone, even if it is a part of bundle (bundle_idx is its number in bundle).
+# Resources of phases of the test (usage) are written to its log. Returns absolute path of saved test.
+def save_test(num, seed, output, err_output, target, fail_tag, bundle_idx=None, usage=None):
+    if bundle_size > 1 and bundle_idx is not None:
+        seed = str(int(seed) + bundle_idx)
     dest = ".." + os.sep + res_dir
-    # Check and/or create compilers codename dir
+    # Compilers codename dir (or gen_fail), fail_tag dir and sde arch dir
     if target is not None:
         dest += os.sep + target.specs.name
     else:
         dest += os.sep + "gen_fail"
-    lock.acquire()
-    common.check_dir_and_create(dest)
-    # Check and/or create fail_tag dir
     dest += os.sep + str(fail_tag)
-    common.check_dir_and_create(dest)
     if target is not None and target.arch.sde_arch.name != "":
         dest += os.sep + target.arch.sde_arch.name
-        common.check_dir_and_create(dest)
-    dest += os.sep + "S_" + seed
-    if os.path.exists(dest):
-        if not os.path.isdir(dest):
-            common.print_and_exit("Can't use '" + dest + "' directory")
-            lock.release()
-            return
+    dest = os.path.abspath(dest + os.sep + "S_" + seed)
+    common.log_msg(logging.DEBUG, "Saving test in " + str(num) + " process to " + dest)
+
+    log = "YARPGEN version: " + str(common.yarpgen_version) + "\n"
+    log += "Seed: " + str(seed) + "\n"
+    log += "Time: " + datetime.datetime.now().strftime('%Y/%m/%d %H:%M:%S') + "\n"
+    log += "Type: " + str(fail_tag) + "\n"
+    if usage is not None:
+        for phase in usage:
+            log += "Usage of " + phase + ": " + str(usage[phase]) + "\n"
+    if target is None:
+        log += "YARPGEN binary: sha256 " + yarpgen_hash + "\n"
     else:
-        os.makedirs(dest)
-    log = open(dest + os.sep + "log.txt", "a")
-    common.log_msg(logging.DEBUG, "Saving test in " + str(num) + "thread to " + dest)
-
-    log.write("YARPGEN version: " + str(common.yarpgen_version) + "\n")
-    log.write("Seed: " + str(seed) + "\n")
-    log.write("Time: " + datetime.datetime.now().strftime('%Y/%m/%d %H:%M:%S') + "\n")
-    log.write("Type: " + str(fail_tag) + "\n")
-    # If it is generator's error, we can't copy test's source files
+        log += "Target: " + str(target.name) + "\n"
+        log += "Compiler version: " + str(target.specs.version) + "\n"
+        log += "Output: \n" + str(output, "utf-8") + "\n\n"
+        log += "Err_output:\n" + str(err_output, "utf-8") + "\n"
+        log += "====================================\n"
+
+    # The same test can be saved with other target, so only its log is appended
+    if os.path.isdir(dest):
+        append_log(dest, log)
+        return dest
+    # Test is saved to temporary dir, which is renamed to its destination, so it doesn't need locks.
+    # Files of the test are linked instead of copying, because they are never modified. Test_Makefile is shared by
+    # all tests, so it is copied (otherwise edit of one saved test would change all of them).
+    tmp_dir = common.make_tmp_dir(dest)
+    append_log(tmp_dir, log)
     if target is None:
-        log.close()
-        shutil.copy(".." + os.sep + "yarpgen", dest)
-        lock.release()
-        return
-    log.write("Target: " + str(target.name) + "\n")
-    log.write("Compiler version: " + str(target.specs.version) + "\n")
-    log.write("Output: \n" + str(output, "utf-8") + "\n\n")
-    log.write("Err_output:\n" + str(err_output, "utf-8") + "\n")
-    log.write("====================================\n")
-    log.close()
-
-    test_files = gen_test_makefile.sources.value.split() + gen_test_makefile.headers.value.split()
-    test_files.append(gen_test_makefile.Test_Makefile_name)
-    for i in test_files:
-        common.check_and_copy(i, dest)
-    lock.release()
+        # If it is generator's error, we can't copy test's source files
+        yarpgen = ".." + os.sep + "yarpgen" if use_result_store else store_yarpgen()
+        common.link_or_copy(yarpgen, tmp_dir + os.sep + "yarpgen")
+    elif bundle_size > 1 and bundle_idx is not None:
+        save_bundle_test(num, seed, tmp_dir)
+    else:
+        materialize_test(seed, num)
+        test_files = gen_test_makefile.sources.value.split() + gen_test_makefile.headers.value.split()
+        for i in [expected_checksum_file_name, ir_file_name, variant_file_name]:
+            if os.path.isfile(i):
+                test_files.append(i)
+        for i in test_files:
+            common.link_or_copy(i, tmp_dir)
+        shutil.copy(test_makefile, tmp_dir)
+    if use_result_store:
+        result_store.pack_dir(tmp_dir, ".." + os.sep + res_dir + os.sep + result_store.store_dir_name)
+    if not common.publish_dir(tmp_dir, dest):
+        append_log(dest, log)
+    return dest
+
+
+# Log is written with one call, so logs of different targets aren't mixed
+def append_log(dest, log):
+    log_fd = os.open(dest + os.sep + "log.txt", os.O_WRONLY | os.O_APPEND | os.O_CREAT, 0o644)
+    try:
+        os.write(log_fd, log.encode("utf-8"))
+    finally:
+        os.close(log_fd)
+
+
+# yarpgen binary is saved once per hash to result/<yarpgen_store_dir> and is linked to saved tests.
+# It is copied to the store, because binary in output dir is overwritten by the next testing.
+def store_yarpgen():
+    path = ".." + os.sep + res_dir + os.sep + yarpgen_store_dir + os.sep + yarpgen_hash
+    if not os.path.isfile(path):
+        tmp_dir = common.make_tmp_dir(path)
+        shutil.copy(".." + os.sep + "yarpgen", tmp_dir + os.sep + yarpgen_hash)
+        try:
+            os.rename(tmp_dir + os.sep + yarpgen_hash, path)
+        finally:
+            shutil.rmtree(tmp_dir)
+    return path
+
+
+# Test <num> of bundle with seed S has seed S + <num>, so it is emitted again by itself with its own Test_Makefile
+def save_bundle_test(num, seed, dest):
+    yarpgen_run_list = [".." + os.sep + "yarpgen", "-q", "-s", seed, "-p", gen_test_makefile.out_profile,
+                        "-d", dest, "-w", dest + os.sep + ir_file_name]
+    ret_code, output, err_output, time_expired, elapsed_time = common.run_cmd(yarpgen_run_list, yarpgen_timeout, num)
+    if ret_code != 0 or time_expired:
+        common.log_msg(logging.WARNING, "Can't re-emit test with seed " + seed + " from bundle")
+    gen_test_makefile.set_bundle_size(1)
+    gen_test_makefile.gen_makefile(dest + os.sep + gen_test_makefile.Test_Makefile_name, True, None)
+    gen_test_makefile.set_bundle_size(bundle_size)
    
 
 ###############################################################################
@@ -489,10 +1173,27 @@ Use specified folder for testing
                         help="Timeout for test system in minutes. -1 means infinity")
     parser.add_argument("--target", dest="target", default="clang ubsan gcc", type=str,
                         help="Targets for testing (see test_sets.txt). By default, possible variants are "
-                             "clang, ubsan and gcc (ubsan is a clang with sanitizer options).")
+                             "clang, ubsan and gcc (ubsan is a clang with sanitizer options). Results are checked "
+                             "against checksum, which is computed by yarpgen, so ubsan isn't required.")
     parser.add_argument("-j", dest="num_jobs", default=multiprocessing.cpu_count(), type=int,
                         help='Maximum number of instances to run in parallel. By defaulti, it is set to'
                              ' number of processor in your system')
+    parser.add_argument("--gen-jobs", dest="gen_jobs", default=gen_jobs, type=int,
+                        help="Number of processes, which generate tests ahead of their compilation")
+    parser.add_argument("--job-mem-limit", dest="job_mem_limit", default=None, type=int,
+                        help="Limit of memory (RSS) of every compilation in MB, it is off by default. New jobs are"
+                             " started only if available memory (MemAvailable of /proc/meminfo) is at least the peak"
+                             " RSS of compilations so far (or the limit before the first one). The limit is enforced"
+                             " only with --job-cgroup.")
+    parser.add_argument("--job-cgroup", dest="job_cgroup", default=None, type=str,
+                        help="cgroup v2 dir, where memory controller is enabled for children (e.g. delegated one)."
+                             " Every compilation runs in its own child cgroup with memory.max of --job-mem-limit."
+                             " Compilations, which are killed by the limit, are reported as " + compfail_limit + ".")
+    parser.add_argument("--job-cpu-limit", dest="job_cpu_limit", default=None, type=int,
+                        help="Limit of cpu time of every compilation in seconds (compiler timeout limits wall time)."
+                             " Compilations, which are killed by the limit, are reported as " + compfail_limit + ".")
+    parser.add_argument("--max-load", dest="max_load", default=max_load, type=float,
+                        help="New jobs are started only if load average is below this value")
     parser.add_argument("--config-file", dest="config_file",
                         default=os.path.join(common.yarpgen_home, gen_test_makefile.default_test_sets_file_name),
                         type=str, help="Configuration file for testing")
@@ -502,6 +1203,40 @@ Use specified folder for testing
                         help="Increase output verbosity")
     parser.add_argument("--stat-log-file", dest="stat_log_file", default="statistics.log", type=str,
                         help="Logfile")
+    parser.add_argument("-p", "--out-profile", dest="out_profile", default=gen_test_makefile.out_profile,
+                        choices=gen_test_makefile.out_profile_list,
+                        help="Output profile of yarpgen: cxx is the default C++ output, light includes only <cstdint>"
+                             " in headers, c produces C99 tests with significantly faster compilation.")
+    parser.add_argument("--mutants", dest="mutant_num", default=mutant_num, type=int,
+                        help="Number of mutants of every test, which are checked as separate tests. Mutant differs"
+                             " from its test in one statement.")
+    parser.add_argument("--family-size", dest="family_size", default=family_size, type=int,
+                        help="Number of members of family of every test, which are checked as separate tests. Member"
+                             " has new body of func for the same variables.")
+    parser.add_argument("--bundle-size", dest="bundle_size", default=bundle_size, type=int,
+                        help="Number of tests, which are linked in one executable to amortize compilation and"
+                             " startup. Test with wrong result is re-emitted and saved alone.")
+    parser.add_argument("--zero-disk", dest="zero_disk", default=False, action="store_true",
+                        help="Pass sources to compilers through stdin and keep objects and executables in memory"
+                             " files. Test is written to disk only if it is saved.")
+    parser.add_argument("--reference-opt", dest="reference_opt", default=None, type=str,
+                        help="Optimization options of reference build (e.g. --reference-opt=-O0). Only func is compiled"
+                             " with options of the target, other files are compiled once per compiler with them.")
+    parser.add_argument("--obj-cache-dir", dest="obj_cache_dir", default=obj_cache.default_cache_dir, type=str,
+                        help="Directory of object cache, which is shared by all processes (see obj_cache.py)")
+    parser.add_argument("--obj-cache-size", dest="obj_cache_size", default=obj_cache.default_max_size, type=int,
+                        help="Size limit of object cache in MB")
+    parser.add_argument("--obj-cache", dest="use_obj_cache", default=False, action="store_true",
+                        help="Reuse compiled objects of the same sources and options (see obj_cache.py).")
+    parser.add_argument("--adaptive-timeouts", dest="adaptive_timeouts", default=False, action="store_true",
+                        help="Use timeouts, which are learned from observed durations of every target for tests of"
+                             " similar size, instead of fixed timeouts of compilation and run.")
+    parser.add_argument("--gen-server", dest="use_gen_server", default=False, action="store_true",
+                        help="Send requests to yarpgen server in every process instead of exec of yarpgen for every"
+                             " test.")
+    parser.add_argument("--result-store", dest="use_result_store", default=False, action="store_true",
+                        help="Save tests as manifests of compressed files in the shared store instead of plain dirs"
+                             " (see result_store.py).")
     args = parser.parse_args()
 
     log_level = logging.DEBUG if args.verbose else logging.INFO
@@ -513,5 +1248,29 @@ Use specified folder for testing
     script_start_time = datetime.datetime.now()
     common.log_msg(logging.DEBUG, "Start time: " + script_start_time.strftime('%Y/%m/%d %H:%M:%S'))
     common.check_python_version()
+    gen_test_makefile.set_out_profile(args.out_profile)
+    if args.bundle_size < 1:
+        common.print_and_exit("Bundle size should be positive")
+    bundle_size = args.bundle_size
+    if args.gen_jobs < 1:
+        common.print_and_exit("Number of generator processes should be positive")
+    gen_jobs = args.gen_jobs
+    if args.job_cgroup is not None and args.job_mem_limit is None:
+        common.print_and_exit("cgroup is used only with --job-mem-limit")
+    common.set_job_limits(args.job_mem_limit, args.job_cpu_limit, args.job_cgroup)
+    max_load = args.max_load
+    use_gen_server = args.use_gen_server
+    zero_disk = args.zero_disk
+    use_result_store = args.use_result_store
+    adaptive_timeouts = args.adaptive_timeouts
+    obj_cache.setup(args.obj_cache_dir if args.use_obj_cache else None, args.obj_cache_size)
+    gen_test_makefile.set_reference_opt(args.reference_opt)
+    if zero_disk and not hasattr(os, "memfd_create"):
+        common.print_and_exit("Zero-disk mode requires python 3.8 or newer on Linux")
+    gen_test_makefile.set_bundle_size(bundle_size)
+    mutant_num = args.mutant_num
+    family_size = args.family_size
+    if (mutant_num > 0 or family_size > 0) and (zero_disk or bundle_size > 1):
+        common.print_and_exit("Mutants and families can't be used in zero-disk mode or with bundles")
     prepare_env_and_start_testing(os.path.abspath(args.out_dir), args.timeout, args.target, args.num_jobs,
                                   args.config_file)
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "archive.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+static const char zero_block [512] = {};
+
+void TarStream::add_file (std::string name, std::string data) {
+    char header [block_size];
+    memset(header, 0, block_size);
+    if (name.size() >= 100) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": too long file name in TarStream::add_file" << std::endl;
+        exit(-1);
+    }
+    // ustar header: name, mode, uid, gid, size, mtime, checksum, type, link name, magic and version
+    memcpy(header, name.c_str(), name.size());
+    snprintf(header + 100, 8, "%07o", 0644);
+    snprintf(header + 108, 8, "%07o", 0);
+    snprintf(header + 116, 8, "%07o", 0);
+    snprintf(header + 124, 12, "%011lo", (unsigned long) data.size());
+    snprintf(header + 136, 12, "%011lo", (unsigned long) time(NULL));
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    // Checksum is computed with checksum field filled with spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < block_size; ++i)
+        checksum += (unsigned char) header[i];
+    snprintf(header + 148, 7, "%06o", checksum);
+
+    out.write(header, block_size);
+    out.write(data.data(), data.size());
+    pad(data.size());
+    out.flush();
+}
+
+void TarStream::pad (size_t size) {
+    if (size % block_size != 0)
+        out.write(zero_block, block_size - size % block_size);
+}
+
+// End of archive is marked by two zero blocks
+void TarStream::finish () {
+    out.write(zero_block, block_size);
+    out.write(zero_block, block_size);
+    out.flush();
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rl {
+
+// Archive collects emitted files instead of writing them to output folder
+class Archive {
+    public:
+        virtual ~Archive () {}
+        virtual void add_file (std::string name, std::string data) = 0;
+};
+
+// TarStream writes files as uncompressed tar (ustar) archive to the stream, so output of generator can be
+// unpacked with "tar x", read with python's tarfile or kept in memory by test harness without temporary files.
+class TarStream : public Archive {
+    public:
+        TarStream (std::ostream& _out) : out(_out) {}
+        void add_file (std::string name, std::string data);
+        // Writes end-of-archive marker
+        void finish ();
+
+    private:
+        static const size_t block_size = 512;
+
+        void pad (size_t size);
+
+        std::ostream& out;
+};
+
+// MemArchive keeps files in memory in the order of emission (it is used by C API, see yarpgen.h)
+class MemArchive : public Archive {
+    public:
+        void add_file (std::string name, std::string data) { files.push_back(std::make_pair(name, data)); }
+        std::vector<std::pair<std::string, std::string>>& get_files () { return files; }
+
+    private:
+        std::vector<std::pair<std::string, std::string>> files;
+};
+}
@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "bundle.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+Bundle::Bundle (std::string _out_folder, Master::OutProfile _out_profile, int _size) :
+                out_folder(_out_folder), out_profile(_out_profile), size(_size), self_check(false) {}
+
+void Bundle::generate () {
+    uint64_t seed = rand_val_gen->get_seed();
+    for (int i = 0; i < size; ++i) {
+        if (i != 0)
+            rand_val_gen = std::make_shared<RandValGen>(RandValGen (seed + i));
+        std::shared_ptr<Master> test = std::make_shared<Master>(out_folder, out_profile);
+        test->set_test_suffix("_" + std::to_string(i));
+        test->generate();
+        tests.push_back(test);
+    }
+}
+
+std::vector<uint64_t> Bundle::get_expected_checksums () {
+    std::vector<uint64_t> ret;
+    for (auto i : tests)
+        ret.push_back(i->get_expected_checksum());
+    return ret;
+}
+
+void Bundle::emit () {
+    for (auto i : tests) {
+        i->emit_func ();
+        i->emit_init ();
+        i->emit_decl ();
+        i->emit_check ();
+    }
+    tests.front()->emit_hash ();
+    emit_main ();
+    emit_expected_checksum ();
+}
+
+void Bundle::write_file (std::string of_name, std::string data) {
+    Master::write_file (out_folder, of_name, data);
+}
+
+std::string Bundle::emit_expected_checksum () {
+    std::string ret = "";
+    for (auto i : tests)
+        ret += std::to_string(i->get_expected_checksum()) + "\n";
+    write_file("expected_checksum.txt", ret);
+    return ret;
+}
+
+std::string Bundle::emit_main () {
+    std::string ret = "";
+    if (out_profile == Master::OutProfile::C)
+        ret += "#include <stdio.h>\n";
+    else if (out_profile == Master::OutProfile::CXX_LIGHT)
+        ret += "#include <cstdio>\n";
+    else
+        ret += "#include <iostream>\n";
+    ret += "\n";
+    for (int i = 0; i < size; ++i) {
+        std::string suffix = "_" + std::to_string(i);
+        ret += "extern void init" + suffix + " ();\n";
+        ret += "extern void foo" + suffix + " ();\n";
+        ret += "extern unsigned long long int checksum" + suffix + " ();\n";
+    }
+    ret += "\n";
+    ret += "int main () {\n";
+    ret += "    int ret = 0;\n";
+    ret += "    unsigned long long int res = 0;\n";
+    for (int i = 0; i < size; ++i) {
+        std::string suffix = "_" + std::to_string(i);
+        ret += "    init" + suffix + " ();\n";
+        ret += "    foo" + suffix + " ();\n";
+        ret += "    res = checksum" + suffix + " ();\n";
+        // Output is flushed after every test, so it shows which test has crashed
+        if (out_profile == Master::OutProfile::CXX)
+            ret += "    std::cout << res << std::endl;\n";
+        else
+            ret += "    printf(\"%llu\\n\", res);\n    fflush(stdout);\n";
+        if (self_check)
+            ret += "    if (res != " + std::to_string(tests.at(i)->get_expected_checksum()) + "ULL)\n"
+                   "        ret = " + std::to_string(Master::self_check_fail_code) + ";\n";
+    }
+    ret += "    return ret;\n";
+    ret += "}";
+    write_file("driver" + std::string(out_profile == Master::OutProfile::C ? ".c" : ".cpp"), ret);
+    return ret;
+}
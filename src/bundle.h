@@ -0,0 +1,50 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "master.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rl {
+
+// Bundle consists of independent tests, which are linked in one program to amortize compilation and startup.
+// Test <num> is generated with seed <seed + num>, so it can be emitted again by itself. Its files and functions
+// have suffix _<num> (variables already have unique names). Driver runs all tests and prints their checksums
+// in the same order as they are listed in expected_checksum.txt (one per line).
+class Bundle {
+    public:
+        Bundle (std::string _out_folder, Master::OutProfile _out_profile, int _size);
+        void generate ();
+        void emit ();
+        // Self-checking driver returns Master::self_check_fail_code if any test has wrong checksum
+        void set_self_check (bool _self_check) { self_check = _self_check; }
+        std::vector<uint64_t> get_expected_checksums ();
+
+    private:
+        void write_file (std::string of_name, std::string data);
+        std::string emit_main ();
+        std::string emit_expected_checksum ();
+
+        std::string out_folder;
+        Master::OutProfile out_profile;
+        int size;
+        bool self_check;
+        std::vector<std::shared_ptr<Master>> tests;
+};
+}
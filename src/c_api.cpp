@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "bundle.h"
+#include "yarpgen.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+static std::atomic<uint64_t> total_test_num (0);
+static std::atomic<uint64_t> total_gen_time_us (0);
+static std::atomic<uint64_t> total_emit_time_us (0);
+static std::atomic<uint64_t> total_file_num (0);
+static std::atomic<uint64_t> total_size (0);
+
+static uint64_t get_elapsed_us (std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static char* copy_str (const std::string& str) {
+    char* ret = (char*) malloc(str.size() + 1);
+    memcpy(ret, str.c_str(), str.size() + 1);
+    return ret;
+}
+
+void yarpgen_default_policy (struct yarpgen_policy* policy) {
+    policy->profile = YARPGEN_CXX;
+    policy->self_check = 0;
+    policy->use_checkpoints = 0;
+    policy->bundle_size = 1;
+}
+
+int yarpgen_generate (uint64_t seed, const struct yarpgen_policy* policy, struct yarpgen_output* out) {
+    if (policy == NULL || out == NULL || policy->profile < YARPGEN_CXX || policy->profile > YARPGEN_C ||
+        policy->bundle_size < 1 || (policy->bundle_size > 1 && policy->use_checkpoints))
+        return -1;
+    Master::OutProfile out_profile = static_cast<Master::OutProfile>(policy->profile);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    RandValGen::reset_name_counters();
+    rand_val_gen = std::make_shared<RandValGen>(RandValGen (seed));
+    out->seed = rand_val_gen->get_seed();
+    std::shared_ptr<MemArchive> archive = std::make_shared<MemArchive>();
+    Master::set_archive(archive);
+    std::vector<uint64_t> checksums;
+    uint64_t gen_time_us = 0;
+    if (policy->bundle_size > 1) {
+        Bundle bundle (".", out_profile, policy->bundle_size);
+        bundle.set_self_check(policy->self_check);
+        bundle.generate();
+        gen_time_us = get_elapsed_us(start);
+        bundle.emit();
+        checksums = bundle.get_expected_checksums();
+    }
+    else {
+        Master mas (".", out_profile);
+        mas.set_self_check(policy->self_check);
+        mas.set_use_checkpoints(policy->use_checkpoints);
+        mas.generate();
+        gen_time_us = get_elapsed_us(start);
+        mas.emit();
+        checksums.push_back(mas.get_expected_checksum());
+    }
+    Master::set_archive(NULL);
+    rand_val_gen = NULL;
+
+    std::vector<std::pair<std::string, std::string>>& files = archive->get_files();
+    out->file_num = files.size();
+    out->files = (struct yarpgen_file*) malloc(files.size() * sizeof(struct yarpgen_file));
+    out->stats.total_size = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        out->files[i].name = copy_str(files.at(i).first);
+        out->files[i].data = copy_str(files.at(i).second);
+        out->files[i].size = files.at(i).second.size();
+        out->stats.total_size += files.at(i).second.size();
+    }
+    out->checksum_num = checksums.size();
+    out->expected_checksums = (uint64_t*) malloc(checksums.size() * sizeof(uint64_t));
+    std::copy(checksums.begin(), checksums.end(), out->expected_checksums);
+    out->stats.test_num = checksums.size();
+    out->stats.gen_time_us = gen_time_us;
+    out->stats.emit_time_us = get_elapsed_us(start) - gen_time_us;
+    out->stats.file_num = files.size();
+
+    total_test_num += out->stats.test_num;
+    total_gen_time_us += out->stats.gen_time_us;
+    total_emit_time_us += out->stats.emit_time_us;
+    total_file_num += out->stats.file_num;
+    total_size += out->stats.total_size;
+    return 0;
+}
+
+void yarpgen_free (struct yarpgen_output* out) {
+    for (size_t i = 0; i < out->file_num; ++i) {
+        free(out->files[i].name);
+        free(out->files[i].data);
+    }
+    free(out->files);
+    free(out->expected_checksums);
+    out->files = NULL;
+    out->file_num = 0;
+    out->expected_checksums = NULL;
+    out->checksum_num = 0;
+}
+
+void yarpgen_get_stats (struct yarpgen_stats* stats) {
+    stats->test_num = total_test_num;
+    stats->gen_time_us = total_gen_time_us;
+    stats->emit_time_us = total_emit_time_us;
+    stats->file_num = total_file_num;
+    stats->total_size = total_size;
+}
@@ -43,6 +43,11 @@ std::shared_ptr<Data> Expr::get_value () {
     }
 }
 
+void Expr::set_operand (uint64_t idx, std::shared_ptr<Expr> operand) {
+    std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": expression has no operands in Expr::set_operand" << std::endl;
+    exit(-1);
+}
+
 std::shared_ptr<Expr> VarUseExpr::set_value (std::shared_ptr<Expr> _expr) {
     std::shared_ptr<Data> _new_value = _expr->get_value();
     if (_new_value->get_class_id() != value->get_class_id()) {
@@ -108,6 +113,42 @@ UB AssignExpr::propagate_value () {
     return NoUB;
 }
 
+UB AssignExpr::repropagate_value () {
+    UB ret_ub = from->repropagate_value();
+    if (!taken || ret_ub != NoUB) {
+        value = from->get_value();
+        return ret_ub;
+    }
+    // Value of bit-field can't be adjusted without IR modification, so such assignment is reported
+    std::shared_ptr<Type> to_type = to->get_value()->get_type();
+    if (to_type->get_is_bit_field()) {
+        std::shared_ptr<BitField> bit_field = std::static_pointer_cast<BitField>(to_type);
+        AtomicType::ScalarTypedVal new_val = std::static_pointer_cast<ScalarVariable>(from->get_value())->get_cur_value();
+        AtomicType::ScalarTypedVal ovf_cmp_val = (bit_field->get_min() > new_val) || (bit_field->get_max() < new_val);
+        if (ovf_cmp_val.val.bool_val) {
+            value = from->get_value();
+            return BitFieldOvf;
+        }
+    }
+    // Bit-field assignments may have been rewritten during generation and lost implicit cast,
+    // so the value is stored through explicit one, while IR stays the same
+    value = from->get_value();
+    std::shared_ptr<Expr> to_type_from = std::make_shared<TypeCastExpr>(from, to_type, true);
+    if (to->get_id() == Node::NodeID::VAR_USE)
+        std::static_pointer_cast<VarUseExpr>(to)->set_value(to_type_from);
+    else
+        std::static_pointer_cast<MemberExpr>(to)->set_value(to_type_from);
+    return NoUB;
+}
+
+void AssignExpr::set_operand (uint64_t idx, std::shared_ptr<Expr> operand) {
+    if (idx != 0) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad operand index in AssignExpr::set_operand" << std::endl;
+        exit(-1);
+    }
+    from = operand;
+}
+
 std::string AssignExpr::emit (std::string offset) {
     std::string ret = offset;
     ret += to->emit();
@@ -149,6 +190,20 @@ std::shared_ptr<TypeCastExpr> TypeCastExpr::generate (std::shared_ptr<Context> c
     return std::make_shared<TypeCastExpr> (from, to_type, false);
 }
 
+UB TypeCastExpr::repropagate_value () {
+    UB ret_ub = expr->repropagate_value();
+    propagate_value();
+    return ret_ub;
+}
+
+void TypeCastExpr::set_operand (uint64_t idx, std::shared_ptr<Expr> operand) {
+    if (idx != 0) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad operand index in TypeCastExpr::set_operand" << std::endl;
+        exit(-1);
+    }
+    expr = operand;
+}
+
 std::string TypeCastExpr::emit (std::string offset) {
     std::string ret = offset;
     //TODO: add parameter to gen_policy
@@ -450,6 +505,20 @@ UB UnaryExpr::propagate_value () {
     return new_val.get_ub();
 }
 
+UB UnaryExpr::repropagate_value () {
+    UB ret_ub = arg->repropagate_value();
+    UB own_ub = propagate_value();
+    return ret_ub != NoUB ? ret_ub : own_ub;
+}
+
+void UnaryExpr::set_operand (uint64_t idx, std::shared_ptr<Expr> operand) {
+    if (idx != 0) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad operand index in UnaryExpr::set_operand" << std::endl;
+        exit(-1);
+    }
+    arg = operand;
+}
+
 std::string UnaryExpr::emit (std::string offset) {
     std::string op_str = offset;
     switch (op) {
@@ -808,6 +877,26 @@ UB BinaryExpr::propagate_value () {
     return new_val.get_ub();
 }
 
+UB BinaryExpr::repropagate_value () {
+    UB ret_ub = arg0->repropagate_value();
+    UB rhs_ub = arg1->repropagate_value();
+    if (ret_ub == NoUB)
+        ret_ub = rhs_ub;
+    UB own_ub = propagate_value();
+    return ret_ub != NoUB ? ret_ub : own_ub;
+}
+
+void BinaryExpr::set_operand (uint64_t idx, std::shared_ptr<Expr> operand) {
+    if (idx > 1) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad operand index in BinaryExpr::set_operand" << std::endl;
+        exit(-1);
+    }
+    if (idx == 0)
+        arg0 = operand;
+    else
+        arg1 = operand;
+}
+
 std::string BinaryExpr::emit (std::string offset) {
     std::string ret = offset;
     ret += "(" + arg0->emit() + ")";
@@ -34,6 +34,11 @@ class Expr : public Node {
         Expr (Node::NodeID _id, std::shared_ptr<Data> _value) : Node(_id), value(_value) {}
         Type::TypeID get_type_id () { return value->get_type()->get_type_id (); }
         std::shared_ptr<Data> get_value ();
+        // Recomputes values of the whole subtree from current values of variables (it is required after IR modification)
+        virtual UB repropagate_value () = 0;
+        // Operands are subtrees, which can be replaced with any expression of the same type
+        virtual std::vector<std::shared_ptr<Expr>> get_operands () { return std::vector<std::shared_ptr<Expr>>(); }
+        virtual void set_operand (uint64_t idx, std::shared_ptr<Expr> operand);
 
     protected:
         virtual bool propagate_type () = 0;
@@ -44,8 +49,10 @@ class Expr : public Node {
 class VarUseExpr : public Expr {
     public:
         VarUseExpr (std::shared_ptr<Data> _var) : Expr(Node::NodeID::VAR_USE, _var) {}
+        std::shared_ptr<Data> get_var () { return value; }
         std::shared_ptr<Expr> set_value (std::shared_ptr<Expr> _expr);
         std::string emit (std::string offset = "") { return value->get_name (); }
+        UB repropagate_value () { return NoUB; }
 
     private:
         bool propagate_type () { return true; }
@@ -55,7 +62,13 @@ class VarUseExpr : public Expr {
 class AssignExpr : public Expr {
     public:
         AssignExpr (std::shared_ptr<Expr> _to, std::shared_ptr<Expr> _from, bool _taken = true);
+        std::shared_ptr<Expr> get_to () { return to; }
+        bool get_taken () { return taken; }
+        void set_taken (bool _taken) { taken = _taken; }
         std::string emit (std::string offset = "");
+        UB repropagate_value ();
+        std::vector<std::shared_ptr<Expr>> get_operands () { return {from}; }
+        void set_operand (uint64_t idx, std::shared_ptr<Expr> operand);
 
     private:
         bool propagate_type ();
@@ -69,7 +82,12 @@ class AssignExpr : public Expr {
 class TypeCastExpr : public Expr {
     public:
         TypeCastExpr (std::shared_ptr<Expr> _expr, std::shared_ptr<Type> _type, bool _is_implicit = false);
+        std::shared_ptr<Type> get_to_type () { return to_type; }
+        bool get_is_implicit () { return is_implicit; }
         std::string emit (std::string offset = "");
+        UB repropagate_value ();
+        std::vector<std::shared_ptr<Expr>> get_operands () { return {expr}; }
+        void set_operand (uint64_t idx, std::shared_ptr<Expr> operand);
         static std::shared_ptr<TypeCastExpr> generate (std::shared_ptr<Context> ctx, std::shared_ptr<Expr> from);
 
     private:
@@ -88,6 +106,7 @@ class ConstExpr : public Expr {
              std::static_pointer_cast<ScalarVariable>(value)->set_cur_value(_val);
         }
         std::string emit (std::string offset = "");
+        UB repropagate_value () { return NoUB; }
         static std::shared_ptr<ConstExpr> generate (std::shared_ptr<Context> ctx);
 
     private:
@@ -126,6 +145,9 @@ class UnaryExpr : public ArithExpr {
         UnaryExpr (Op _op, std::shared_ptr<Expr> _arg);
         Op get_op () { return op; }
         std::string emit (std::string offset = "");
+        UB repropagate_value ();
+        std::vector<std::shared_ptr<Expr>> get_operands () { return {arg}; }
+        void set_operand (uint64_t idx, std::shared_ptr<Expr> operand);
         static std::shared_ptr<UnaryExpr> generate (std::shared_ptr<Context> ctx, std::vector<std::shared_ptr<Expr>> inp, int par_depth);
 
     private:
@@ -168,6 +190,9 @@ class BinaryExpr : public ArithExpr {
         BinaryExpr (Op _op, std::shared_ptr<Expr> lhs, std::shared_ptr<Expr> rhs);
         Op get_op () { return op; }
         std::string emit (std::string offset = "");
+        UB repropagate_value ();
+        std::vector<std::shared_ptr<Expr>> get_operands () { return {arg0, arg1}; }
+        void set_operand (uint64_t idx, std::shared_ptr<Expr> operand);
         static std::shared_ptr<BinaryExpr> generate (std::shared_ptr<Context> ctx, std::vector<std::shared_ptr<Expr>> inp, int par_depth);
 
     private:
@@ -188,7 +213,12 @@ class MemberExpr : public Expr {
         MemberExpr (std::shared_ptr<MemberExpr> _member_expr, uint64_t _identifier) :
                     Expr(Node::NodeID::MEMBER, _member_expr->get_value()), member_expr(_member_expr), struct_var(NULL), identifier(_identifier) { propagate_type(); propagate_value(); }
         std::shared_ptr<Expr> set_value (std::shared_ptr<Expr> _expr);
+        std::shared_ptr<Struct> get_struct_var () { return struct_var; }
+        std::shared_ptr<MemberExpr> get_member_expr () { return member_expr; }
+        uint64_t get_identifier () { return identifier; }
         std::string emit (std::string offset = "");
+        // Members are bound to struct objects, so their values are always up to date
+        UB repropagate_value () { return NoUB; }
 
     private:
         bool propagate_type ();
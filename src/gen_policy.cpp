@@ -15,6 +15,8 @@ limitations under the License.
 */
 
 //////////////////////////////////////////////////////////////////////////////
+#include <sstream>
+
 #include "gen_policy.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -56,10 +58,10 @@ int MAX_BIT_FIELD_SIZE = 2;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-std::shared_ptr<RandValGen> rl::rand_val_gen;
-uint64_t RandValGen::struct_type_num = 0;
-uint64_t RandValGen::scalar_var_num = 0;
-uint64_t RandValGen::struct_var_num = 0;
+thread_local std::shared_ptr<RandValGen> rl::rand_val_gen;
+thread_local uint64_t RandValGen::struct_type_num = 0;
+thread_local uint64_t RandValGen::scalar_var_num = 0;
+thread_local uint64_t RandValGen::struct_var_num = 0;
 
 RandValGen::RandValGen (uint64_t _seed) {
     if (_seed != 0) {
@@ -69,10 +71,24 @@ RandValGen::RandValGen (uint64_t _seed) {
         std::random_device rd;
         seed = rd ();
     }
-    std::cout << "/*SEED " << seed << "*/" << std::endl;
     rand_gen = std::mt19937_64(seed);
 }
 
+std::string RandValGen::get_state () {
+    std::ostringstream state;
+    state << struct_type_num << " " << scalar_var_num << " " << struct_var_num << " " << rand_gen;
+    return state.str();
+}
+
+void RandValGen::set_state (std::string state) {
+    std::istringstream state_stream (state);
+    state_stream >> struct_type_num >> scalar_var_num >> struct_var_num >> rand_gen;
+    if (!state_stream) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad state in RandValGen::set_state" << std::endl;
+        exit(-1);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 GenPolicy::GenPolicy () {
@@ -108,9 +124,11 @@ GenPolicy::GenPolicy () {
     bit_field_prob.push_back(Probability<BitFieldID>(UNNAMED, 30));
     bit_field_prob.push_back(Probability<BitFieldID>(NAMED, 60));
     bit_field_prob.push_back(Probability<BitFieldID>(MAX_BIT_FIELD_ID, 10));
+    allow_wide_bit_fields = true;
 
     out_data_type_prob.push_back(Probability<OutDataTypeID>(VAR, 70));
     out_data_type_prob.push_back(Probability<OutDataTypeID>(STRUCT, 30));
+    allow_new_out_vars = true;
 
     max_arith_depth = MAX_ARITH_DEPTH;
 
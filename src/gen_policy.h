@@ -72,15 +72,24 @@ class RandValGen {
         std::string get_scalar_var_name() { return "var_" + std::to_string(++scalar_var_num); }
         std::string get_struct_var_name() { return "struct_obj_" + std::to_string(++struct_var_num); }
 
+        uint64_t get_seed () { return seed; }
+        // State of random generator and name counters is saved with IR, so generation continues after load
+        // in the same way as in original run (e.g. new bodies of test family)
+        std::string get_state ();
+        void set_state (std::string state);
+        // Names are unique in the thread (tests of bundle are linked together), so standalone test starts from zero
+        static void reset_name_counters () { struct_type_num = scalar_var_num = struct_var_num = 0; }
+
     private:
         uint64_t seed;
         std::mt19937_64 rand_gen;
-        static uint64_t struct_type_num;
-        static uint64_t scalar_var_num;
-        static uint64_t struct_var_num;
+        static thread_local uint64_t struct_type_num;
+        static thread_local uint64_t scalar_var_num;
+        static thread_local uint64_t struct_var_num;
 };
 
-extern std::shared_ptr<RandValGen> rand_val_gen;
+// Generator state is thread-local, so tests can be generated in parallel threads (see yarpgen.h)
+extern thread_local std::shared_ptr<RandValGen> rand_val_gen;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -234,12 +243,18 @@ class GenPolicy {
         std::vector<Probability<Data::VarClassID>>& get_member_class_prob () { return member_class_prob; }
         void add_out_data_type_prob(Probability<OutDataTypeID> prob) { out_data_type_prob.push_back(prob); }
         std::vector<Probability<OutDataTypeID>> get_out_data_type_prob() { return out_data_type_prob; }
+        // Without new output variables declarations of the test don't change, so only foo () should be re-emitted
+        void set_allow_new_out_vars (bool _allow_new_out_vars) { allow_new_out_vars = _allow_new_out_vars; }
+        bool get_allow_new_out_vars () { return allow_new_out_vars; }
         void set_min_bit_field_size (uint64_t _min_bit_field_size) { min_bit_field_size = _min_bit_field_size; }
         uint64_t get_min_bit_field_size () { return min_bit_field_size; }
         void set_max_bit_field_size (uint64_t _max_bit_field_size) { max_bit_field_size = _max_bit_field_size; }
         uint64_t get_max_bit_field_size () { return max_bit_field_size; }
         std::vector<Probability<BitFieldID>>& get_bit_field_prob () { return bit_field_prob; }
         void add_bit_field_prob(Probability<BitFieldID> prob) { bit_field_prob.push_back(prob); }
+        // Bit-fields, which are wider than their type or have type wider than int, are valid only in C++
+        void set_allow_wide_bit_fields (bool _allow_wide_bit_fields) { allow_wide_bit_fields = _allow_wide_bit_fields; }
+        bool get_allow_wide_bit_fields () { return allow_wide_bit_fields; }
 
     private:
         // Number of allowed integer types
@@ -265,9 +280,11 @@ class GenPolicy {
         std::vector<Probability<Data::VarClassID>> member_class_prob;
         uint64_t max_struct_depth;
         std::vector<Probability<OutDataTypeID>> out_data_type_prob;
+        bool allow_new_out_vars;
         uint64_t min_bit_field_size;
         uint64_t max_bit_field_size;
         std::vector<Probability<BitFieldID>> bit_field_prob;
+        bool allow_wide_bit_fields;
 
         void set_modifier (bool value, Type::Mod modifier);
         bool get_modifier (Type::Mod modifier);
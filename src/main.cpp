@@ -17,13 +17,18 @@ limitations under the License.
 //////////////////////////////////////////////////////////////////////////////
 
 #include <getopt.h>
+#include <sys/stat.h>
 #include <cstdint>
 #include <iostream>
 
 #include "type.h"
 #include "variable.h"
 #include "sym_table.h"
+#include "bundle.h"
 #include "master.h"
+#include "mutator.h"
+#include "reducer.h"
+#include "server.h"
 
 #ifndef BUILD_DATE
 #define BUILD_DATE __DATE__
@@ -41,7 +46,7 @@ void printVersion () {
 
 extern void self_test();
 
-int main (int argc, char* argv[]) {
+int run_generator (int argc, char* argv[]) {
 
     extern char *optarg;
     extern int optind;
@@ -49,12 +54,37 @@ int main (int argc, char* argv[]) {
     std::string out_dir = "./";
     int c;
     uint64_t seed = 0;
-    static char usage[] = "usage: [-q -v -d <out_dir> -s <seed>\n";
+    Master::OutProfile out_profile = Master::OutProfile::CXX;
+    static char usage[] = "usage: [reduce] [-q -v -c -k -o -d <out_dir> -s <seed> -p <cxx|light|c>\n"
+                          "       -i <interestingness script> -j <jobs> -w <ir_file> -l <ir_file> -m <mutants>\n"
+                          "       -f <family size> -b <bundle size>]\n"
+                          "       server [-t <timeout in seconds>]\n"
+                          "  -k also emits variant of the test with checkpoints to <out_dir>/checkpoints for triage,\n"
+                          "     the test itself is emitted without them\n";
     bool opt_parse_err = 0;
     bool quiet = false;
     bool print_version = false;
+    bool self_check = false;
+    bool use_checkpoints = false;
+    bool reduce = false;
+    std::string reduce_script = "";
+    int reduce_jobs = 1;
+    std::string save_ir_file = "";
+    std::string load_ir_file = "";
+    int mutant_num = 0;
+    int family_num = 0;
+    int bundle_size = 1;
+    bool stream_output = false;
+
+    // Reduce mode re-generates the test from the seed (or loads it) and simplifies it
+    if (argc > 1 && std::string(argv[1]) == "reduce") {
+        reduce = true;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
 
-    while ((c = getopt(argc, argv, "qvhrd:s:")) != -1)
+    while ((c = getopt(argc, argv, "qvhrckod:s:p:i:j:w:l:m:f:b:")) != -1)
         switch (c) {
         case 'd':
             out_dir = std::string(optarg);
@@ -62,6 +92,48 @@ int main (int argc, char* argv[]) {
         case 's':
             seed = strtoull(optarg, &pEnd, 10);
             break;
+        case 'p':
+            if (std::string(optarg) == "cxx")
+                out_profile = Master::OutProfile::CXX;
+            else if (std::string(optarg) == "light")
+                out_profile = Master::OutProfile::CXX_LIGHT;
+            else if (std::string(optarg) == "c")
+                out_profile = Master::OutProfile::C;
+            else {
+                std::cerr << "Unknown output profile: " << optarg << std::endl;
+                opt_parse_err = true;
+            }
+            break;
+        case 'c':
+            self_check = true;
+            break;
+        case 'k':
+            use_checkpoints = true;
+            break;
+        case 'o':
+            stream_output = true;
+            break;
+        case 'i':
+            reduce_script = std::string(optarg);
+            break;
+        case 'j':
+            reduce_jobs = strtol(optarg, &pEnd, 10);
+            break;
+        case 'w':
+            save_ir_file = std::string(optarg);
+            break;
+        case 'l':
+            load_ir_file = std::string(optarg);
+            break;
+        case 'm':
+            mutant_num = strtol(optarg, &pEnd, 10);
+            break;
+        case 'f':
+            family_num = strtol(optarg, &pEnd, 10);
+            break;
+        case 'b':
+            bundle_size = strtol(optarg, &pEnd, 10);
+            break;
         case 'q':
             quiet = true;
             break;
@@ -82,6 +154,19 @@ int main (int argc, char* argv[]) {
         std::cerr << "Using default options" << std::endl;
         std::cerr << "For help type " << argv [0] << " -h" << std::endl;
     }
+    if (reduce && reduce_script == "") {
+        std::cerr << "Interestingness script is required for reduce mode" << std::endl;
+        opt_parse_err = true;
+    }
+    if (bundle_size > 1 && (reduce || use_checkpoints || save_ir_file != "" || load_ir_file != "" ||
+                            mutant_num > 0 || family_num > 0)) {
+        std::cerr << "Bundle can't be reduced, saved, loaded, mutated or used with checkpoints" << std::endl;
+        opt_parse_err = true;
+    }
+    if (stream_output && (reduce || mutant_num > 0 || family_num > 0)) {
+        std::cerr << "Output can't be streamed in reduce mode or with mutants and families" << std::endl;
+        opt_parse_err = true;
+    }
     if (opt_parse_err) {
         std::cerr << usage << std::endl;
         exit(-1);
@@ -92,18 +177,82 @@ int main (int argc, char* argv[]) {
         exit(0);
     }
 
+    // Files of the test are streamed to stdout as tar archive, so all other output (e.g. seed) goes to stderr
+    std::ostream archive_out (std::cout.rdbuf());
+    std::shared_ptr<TarStream> archive = NULL;
+    if (stream_output) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+        archive = std::make_shared<TarStream>(archive_out);
+        Master::set_archive(archive);
+    }
+
     rand_val_gen = std::make_shared<RandValGen>(RandValGen (seed));
+    // Loaded IR has its own seed, it is printed after loading
+    if (load_ir_file == "")
+        std::cout << "/*SEED " << rand_val_gen->get_seed() << "*/" << std::endl;
 
 //    self_test();
 
-    Master mas (out_dir);
-    mas.generate ();
-    mas.emit_func ();
-    mas.emit_init ();
-    mas.emit_decl ();
-    mas.emit_hash ();
-    mas.emit_check ();
-    mas.emit_main ();
+    if (bundle_size > 1) {
+        Bundle bundle (out_dir, out_profile, bundle_size);
+        bundle.set_self_check (self_check);
+        bundle.generate ();
+        bundle.emit ();
+        if (archive != NULL)
+            archive->finish ();
+        return 0;
+    }
+
+    Master mas (out_dir, out_profile);
+    mas.set_self_check (self_check);
+    mas.set_use_checkpoints (use_checkpoints);
+    // Loaded IR is used instead of generated one, Master::load restores its seed
+    if (load_ir_file != "") {
+        mas.load (load_ir_file);
+        std::cout << "/*SEED " << rand_val_gen->get_seed() << "*/" << std::endl;
+    }
+    else
+        mas.generate ();
+    if (reduce) {
+        Reducer reducer (mas, out_dir, reduce_script, reduce_jobs);
+        reducer.reduce ();
+    }
+    else
+        mas.emit ();
+    // Mutants are emitted after base test, so they can reuse its files
+    if (mutant_num > 0 && !reduce) {
+        Mutator mutator (mas, out_dir, mutant_num);
+        mutator.mutate ();
+    }
+    if (save_ir_file != "")
+        mas.save (save_ir_file);
+    // Family members share external variables with base test, so only files, which depend on foo (), are emitted
+    for (int i = 0; i < family_num && !reduce; ++i) {
+        std::string family_dir = out_dir + "/family_" + std::to_string(i);
+        mkdir(family_dir.c_str(), 0755);
+        mas.generate_body ();
+        mas.set_out_folder (family_dir);
+        mas.emit_variant ();
+    }
+    if (archive != NULL)
+        archive->finish ();
 
     return 0;
 }
+
+int main (int argc, char* argv[]) {
+    // Server mode reads options of every test from stdin and runs generator with them in a forked process
+    if (argc > 1 && std::string(argv[1]) == "server") {
+        unsigned timeout = 0;
+        if (argc == 4 && std::string(argv[2]) == "-t")
+            timeout = strtoul(argv[3], NULL, 10);
+        else if (argc != 2) {
+            std::cerr << "usage: server [-t <timeout in seconds>]" << std::endl;
+            exit(-1);
+        }
+        Server server (run_generator, timeout);
+        server.serve ();
+        return 0;
+    }
+    return run_generator (argc, argv);
+}
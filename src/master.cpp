@@ -16,38 +16,224 @@ limitations under the License.
 
 //////////////////////////////////////////////////////////////////////////////
 
+#include <sys/stat.h>
+
 #include "master.h"
+#include "serializer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 using namespace rl;
 
-Master::Master (std::string _out_folder) {
+static std::string emit_hash_step (std::string val, std::string seed = "seed") {
+    return seed + " ^= " + val + " + 0x9e3779b9 + (" + seed + "<<6) + (" + seed + ">>2);";
+}
+
+static void form_checkpoints (std::shared_ptr<Stmt> stmt, std::vector<std::shared_ptr<ExprStmt>>& checkpoints) {
+    switch (stmt->get_id()) {
+        case Node::NodeID::EXPR: {
+            std::shared_ptr<ExprStmt> expr_stmt = std::static_pointer_cast<ExprStmt>(stmt);
+            // Statements in not taken branches are never executed, so they can't have checkpoints
+            if (expr_stmt->get_taken()) {
+                expr_stmt->set_checkpoint_id(checkpoints.size());
+                checkpoints.push_back(expr_stmt);
+            }
+            else
+                expr_stmt->set_checkpoint_id(-1);
+            break;
+        }
+        case Node::NodeID::SCOPE:
+            for (auto i : std::static_pointer_cast<ScopeStmt>(stmt)->get_scope())
+                form_checkpoints(i, checkpoints);
+            break;
+        case Node::NodeID::IF: {
+            std::shared_ptr<IfStmt> if_stmt = std::static_pointer_cast<IfStmt>(stmt);
+            form_checkpoints(if_stmt->get_if_branch(), checkpoints);
+            if (if_stmt->get_else_branch() != NULL)
+                form_checkpoints(if_stmt->get_else_branch(), checkpoints);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+Master::Master (std::string _out_folder, OutProfile _out_profile) {
     out_folder = _out_folder;
+    out_profile = _out_profile;
+    self_check = false;
+    expected_checksum = 0;
+    use_checkpoints = false;
+    emit_checkpoints = false;
+    test_suffix = "";
+    set_profile_gen_policy();
     extern_inp_sym_table = std::make_shared<SymbolTable> ();
     extern_mix_sym_table = std::make_shared<SymbolTable> ();
     extern_out_sym_table = std::make_shared<SymbolTable> ();
 }
 
+void Master::set_profile_gen_policy () {
+    if (out_profile == C) {
+        gen_policy.set_allow_static_members(false);
+        gen_policy.set_allow_wide_bit_fields(false);
+    }
+}
+
 void Master::generate () {
     Context ctx (gen_policy, NULL, Node::NodeID::MAX_STMT_ID, true);
     ctx.set_extern_inp_sym_table (extern_inp_sym_table);
     ctx.set_extern_mix_sym_table (extern_mix_sym_table);
     ctx.set_extern_out_sym_table (extern_out_sym_table);
 
+    std::shared_ptr<Context> root_ctx = std::make_shared<Context>(ctx);
+    ScopeStmt::form_extern_sym_table(root_ctx);
+    // Every output struct member is assigned only once in the body, so the list is saved for other bodies
+    out_avail_members = extern_out_sym_table->get_avail_members();
+    program = ScopeStmt::generate(root_ctx);
+    // Emission of variable definitions resets current values to initial ones, so we should do it right now
+    expected_checksum = calc_expected_checksum();
+}
+
+void Master::restore_init_values () {
+    for (auto sym_table : {extern_inp_sym_table, extern_mix_sym_table, extern_out_sym_table})
+        sym_table->restore_init_values();
+}
+
+void Master::generate_body () {
+    restore_init_values();
+    extern_out_sym_table->get_avail_members() = out_avail_members;
+    // New output variables would change declarations of the test
+    GenPolicy body_gen_policy = gen_policy;
+    body_gen_policy.set_allow_new_out_vars(false);
+    Context ctx (body_gen_policy, NULL, Node::NodeID::MAX_STMT_ID, true);
+    ctx.set_extern_inp_sym_table (extern_inp_sym_table);
+    ctx.set_extern_mix_sym_table (extern_mix_sym_table);
+    ctx.set_extern_out_sym_table (extern_out_sym_table);
+
     program = ScopeStmt::generate(std::make_shared<Context>(ctx));
+    expected_checksum = calc_expected_checksum();
+}
+
+bool Master::repropagate () {
+    restore_init_values();
+    if (program->repropagate_value(true) != NoUB)
+        return false;
+    expected_checksum = calc_expected_checksum();
+    return true;
+}
+
+// Checks that struct type doesn't use features, which are forbidden by C profile
+static bool is_c_compatible (std::shared_ptr<StructType> struct_type) {
+    for (uint64_t i = 0; i < struct_type->get_num_of_shadow_members(); ++i) {
+        std::shared_ptr<Type> member_type = struct_type->get_shadow_member(i)->get_type();
+        if (member_type->get_is_static())
+            return false;
+        if (member_type->is_struct_type() && !is_c_compatible(std::static_pointer_cast<StructType>(member_type)))
+            return false;
+        if (member_type->get_is_bit_field()) {
+            std::shared_ptr<BitField> bit_field = std::static_pointer_cast<BitField>(member_type);
+            uint64_t type_width = bit_field->get_int_type_id() == Type::IntegerTypeID::BOOL ? 1 :
+                                  IntegerType::init(bit_field->get_int_type_id())->get_bit_size();
+            if (bit_field->get_int_type_id() > Type::IntegerTypeID::UINT || bit_field->get_bit_field_width() > type_width)
+                return false;
+        }
+    }
+    return true;
+}
+
+void Master::save (std::string file_name) {
+    IRImage image = {program, extern_inp_sym_table, extern_mix_sym_table, extern_out_sym_table, expected_checksum,
+                     out_avail_members, rand_val_gen->get_seed(), rand_val_gen->get_state()};
+    IRWriter writer;
+    writer.write(file_name, image);
 }
 
-void Master::write_file (std::string of_name, std::string data) {
+void Master::load (std::string file_name) {
+    IRReader reader (file_name);
+    IRImage image = reader.read();
+    program = image.program;
+    extern_inp_sym_table = image.extern_inp_sym_table;
+    extern_mix_sym_table = image.extern_mix_sym_table;
+    extern_out_sym_table = image.extern_out_sym_table;
+    out_avail_members = image.out_avail_members;
+    // Policy is formed randomly, so it is formed again from the seed of the test, and then generator continues
+    // from its state after the test
+    *rand_val_gen = RandValGen(image.seed);
+    gen_policy = GenPolicy();
+    set_profile_gen_policy();
+    rand_val_gen->set_state(image.gen_state);
+
+    if (out_profile == C) {
+        for (auto sym_table : {extern_inp_sym_table, extern_mix_sym_table, extern_out_sym_table})
+            for (auto struct_type : sym_table->get_struct_types())
+                if (!is_c_compatible(struct_type)) {
+                    std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": IR from " << file_name
+                              << " can't be emitted as C in Master::load" << std::endl;
+                    exit(-1);
+                }
+    }
+    if (!repropagate() || expected_checksum != image.expected_checksum) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": IR from " << file_name
+                  << " is inconsistent in Master::load" << std::endl;
+        exit(-1);
+    }
+}
+
+void Master::emit () {
+    emit_func ();
+    emit_init ();
+    emit_decl ();
+    emit_hash ();
+    emit_check ();
+    emit_main ();
+    emit_expected_checksum ();
+    // Checkpoint stores change optimization of the test, so the test itself is emitted without them
+    if (use_checkpoints)
+        emit_checkpoint_variant ();
+}
+
+void Master::emit_checkpoint_variant () {
+    form_checkpoints(program, checkpoints);
+    if (archive == NULL)
+        mkdir((out_folder + "/" + checkpoint_folder).c_str(), 0755);
+    emit_checkpoints = true;
+    emit_func ();
+    emit_init ();
+    emit_decl ();
+    emit_hash ();
+    emit_check ();
+    emit_main ();
+    emit_expected_checksum ();
+    emit_checkpoints = false;
+    for (auto i : checkpoints)
+        i->set_checkpoint_id(-1);
+    checkpoints.clear();
+}
+
+void Master::emit_variant () {
+    emit_func ();
+    emit_expected_checksum ();
+    // Self-checking driver contains expected checksum
+    if (self_check)
+        emit_main ();
+}
+
+thread_local std::shared_ptr<Archive> Master::archive = NULL;
+
+void Master::write_file (std::string folder, std::string of_name, std::string data) {
+    if (archive != NULL) {
+        archive->add_file(of_name, data);
+        return;
+    }
     std::ofstream out_file;
-    out_file.open (out_folder + "/" + of_name);
+    out_file.open (folder + "/" + of_name);
     out_file << data;
     out_file.close ();
 }
 
 std::string Master::emit_init () {
     std::string ret = "";
-    ret += "#include \"init.h\"\n\n";
+    ret += "#include \"init" + test_suffix + ".h\"\n\n";
 
     ret += extern_inp_sym_table->emit_variable_def() + "\n\n";
     ret += extern_mix_sym_table->emit_variable_def() + "\n\n";
@@ -58,63 +244,120 @@ std::string Master::emit_init () {
     //TODO: what if we extand struct types in mix_sym_table and out_sym_table
     ret += extern_inp_sym_table->emit_struct_type_static_memb_def() + "\n\n";
 
-    ret += "void init () {\n";
+    ret += "void init" + test_suffix + " () {\n";
     ret += extern_inp_sym_table->emit_struct_init ("    ");
     ret += extern_mix_sym_table->emit_struct_init ("    ");
     ret += extern_out_sym_table->emit_struct_init ("    ");
     ret += "}";
 
-    write_file("init.cpp", ret);
+    write_file("init" + test_suffix + get_src_ext(), ret);
     return ret;
 }
 
 std::string Master::emit_decl () {
     std::string ret = "";
-    ret += "#include <cstdint>\n";
-    ret += "#include <iostream>\n";
-    ret += "#include <array>\n";
-    ret += "#include <vector>\n";
-    ret += "#include <valarray>\n\n";
-
-    ret += "void hash(unsigned long long int &seed, unsigned long long int const &v);\n\n";
+    if (out_profile == C) {
+        ret += "#include <stdint.h>\n";
+        ret += "#include <stdbool.h>\n\n";
+        ret += "void hash(unsigned long long int *seed, unsigned long long int const v);\n\n";
+    }
+    else {
+        ret += "#include <cstdint>\n";
+        if (out_profile == CXX) {
+            ret += "#include <iostream>\n";
+            ret += "#include <array>\n";
+            ret += "#include <vector>\n";
+            ret += "#include <valarray>\n";
+        }
+        ret += "\n";
+        ret += "void hash(unsigned long long int &seed, unsigned long long int const &v);\n\n";
+    }
 
     ret += extern_inp_sym_table->emit_variable_extern_decl() + "\n\n";
     ret += extern_mix_sym_table->emit_variable_extern_decl() + "\n\n";
     ret += extern_out_sym_table->emit_variable_extern_decl() + "\n\n";
+    if (checkpoints.size() != 0)
+        ret += "extern unsigned long long int checkpoint_vals [" + std::to_string(checkpoints.size()) + "];\n\n";
     //TODO: what if we extand struct types in mix_sym_tabl
+    if (out_profile == C) {
+        for (auto i : extern_inp_sym_table->get_struct_types())
+            ret += "typedef struct " + i->get_simple_name() + " " + i->get_simple_name() + ";\n";
+        ret += "\n";
+    }
     ret += extern_inp_sym_table->emit_struct_type_def() + "\n\n";
     ret += extern_inp_sym_table->emit_struct_extern_decl() + "\n\n";
     ret += extern_mix_sym_table->emit_struct_extern_decl() + "\n\n";
     ret += extern_out_sym_table->emit_struct_extern_decl() + "\n\n";
 
-    write_file("init.h", ret);
+    write_file("init" + test_suffix + ".h", ret);
     return ret;
 }
 
 std::string Master::emit_func () {
     std::string ret = "";
-    ret += "#include \"init.h\"\n\n";
-    ret += "void foo () {\n";
+    ret += "#include \"init" + test_suffix + ".h\"\n\n";
+    ret += "void foo" + test_suffix + " () {\n";
     ret += program->emit();
     ret += "}";
-    write_file("func.cpp", ret);
+    write_file("func" + test_suffix + get_src_ext(), ret);
     return ret;
 }
 
 std::string Master::emit_hash () {
-    std::string ret = "#include <functional>\n";
-    ret += "void hash(unsigned long long int &seed, unsigned long long int const &v) {\n";
-    ret += "    seed ^= v + 0x9e3779b9 + (seed<<6) + (seed>>2);\n";
+    std::string ret = "";
+    if (out_profile == C) {
+        ret += "void hash(unsigned long long int *seed, unsigned long long int const v) {\n";
+        ret += "    " + emit_hash_step("v", "(*seed)") + "\n";
+    }
+    else {
+        if (out_profile == CXX)
+            ret += "#include <functional>\n";
+        ret += "void hash(unsigned long long int &seed, unsigned long long int const &v) {\n";
+        ret += "    " + emit_hash_step("v") + "\n";
+    }
     ret += "}\n";
-    write_file("hash.cpp", ret);
+    write_file("hash" + get_src_ext(), ret);
     return ret;
 }
 
-std::string Master::emit_check () { // TODO: rewrite with IR
+std::vector<std::shared_ptr<Expr>> Master::form_check_exprs () {
+    // Order of hashing is the same as it was in per-variable hash calls
+    std::vector<std::shared_ptr<Expr>> ret;
+    for (auto sym_table : {extern_mix_sym_table, extern_out_sym_table}) {
+        std::vector<std::shared_ptr<Expr>> var_exprs = sym_table->form_variable_check_exprs();
+        ret.insert(ret.end(), var_exprs.begin(), var_exprs.end());
+    }
+    for (auto sym_table : {extern_mix_sym_table, extern_out_sym_table}) {
+        std::vector<std::shared_ptr<Expr>> struct_exprs = sym_table->form_struct_check_exprs();
+        ret.insert(ret.end(), struct_exprs.begin(), struct_exprs.end());
+    }
+    return ret;
+}
+
+// Final values of all checked variables are known after generation, so we can hash them in the same order
+// and with the same conversions as generated checksum () does.
+uint64_t Master::calc_expected_checksum () {
+    std::shared_ptr<IntegerType> hash_type = IntegerType::init(Type::IntegerTypeID::ULLINT);
+    uint64_t seed = 0;
+    for (auto i : form_check_exprs()) {
+        std::shared_ptr<TypeCastExpr> to_hash_type = std::make_shared<TypeCastExpr>(i, hash_type, true);
+        uint64_t val = std::static_pointer_cast<ScalarVariable>(to_hash_type->get_value())->get_cur_value().val.ullint_val;
+        seed ^= val + 0x9e3779b9 + (seed<<6) + (seed>>2);
+    }
+    return seed;
+}
+
+std::string Master::emit_expected_checksum () {
+    std::string ret = std::to_string(expected_checksum) + "\n";
+    write_file("expected_checksum.txt", ret);
+    return ret;
+}
+
+std::string Master::emit_check () {
     std::string ret = "";
-    ret += "#include \"init.h\"\n\n";
+    ret += "#include \"init" + test_suffix + ".h\"\n\n";
 
-    ret += "unsigned long long int checksum () {\n";
+    ret += "unsigned long long int checksum" + test_suffix + " () {\n";
 
     std::shared_ptr<ScalarVariable> seed = std::make_shared<ScalarVariable>("seed", IntegerType::init(Type::IntegerTypeID::ULLINT));
     std::shared_ptr<VarUseExpr> seed_use = std::make_shared<VarUseExpr>(seed);
@@ -127,31 +370,125 @@ std::string Master::emit_check () { // TODO: rewrite with IR
 
     ret += seed_decl->emit("    ") + "\n";
 
-    ret += extern_mix_sym_table->emit_variable_check ("    ");
-    ret += extern_out_sym_table->emit_variable_check ("    ");
-
-    ret += extern_mix_sym_table->emit_struct_check ("    ");
-    ret += extern_out_sym_table->emit_struct_check ("    ");
+    // Every checked scalar is described by its address and type in static tables, which are hashed by hash()
+    // call in a loop, instead of separate hash() call per scalar. Bit-fields can't be addressed, so their values
+    // are gathered into separate table. The order of hashing and implicit conversion to hash type are the same
+    // as they were in per-scalar hash() calls, so the checksum doesn't change.
+    std::vector<std::shared_ptr<Expr>> check_exprs = form_check_exprs();
+    if (check_exprs.size() != 0) {
+        std::shared_ptr<IntegerType> hash_type = IntegerType::init(Type::IntegerTypeID::ULLINT);
+        std::string addr_table = "";
+        std::string type_table = "";
+        std::string bit_field_table = "";
+        uint64_t bit_field_num = 0;
+        std::vector<bool> used_types (Type::IntegerTypeID::MAX_INT_ID, false);
+        for (auto i : check_exprs) {
+            std::shared_ptr<Type> check_type = i->get_value()->get_type();
+            if (check_type->get_is_bit_field()) {
+                std::shared_ptr<TypeCastExpr> to_hash_type = std::make_shared<TypeCastExpr>(i, hash_type, true);
+                bit_field_table += "        " + to_hash_type->emit() + ",\n";
+                addr_table += "        0,\n";
+                type_table += std::to_string(Type::IntegerTypeID::MAX_INT_ID) + ", ";
+                bit_field_num++;
+            }
+            else {
+                addr_table += "        &" + i->emit() + ",\n";
+                type_table += std::to_string(check_type->get_int_type_id()) + ", ";
+                used_types.at(check_type->get_int_type_id()) = true;
+            }
+        }
+
+        std::string check_num = std::to_string(check_exprs.size());
+        ret += "    static const volatile void * const check_addrs [" + check_num + "] = {\n" + addr_table + "    };\n";
+        ret += "    static const unsigned char check_types [" + check_num + "] = {" + type_table + "};\n";
+        if (bit_field_num != 0) {
+            ret += "    " + hash_type->get_simple_name() + " const bit_field_vals [" + std::to_string(bit_field_num) + "] = {\n" + bit_field_table + "    };\n";
+            ret += "    unsigned int bit_field_idx = 0;\n";
+        }
+        ret += "    for (unsigned int i = 0; i < " + check_num + "; ++i) {\n";
+        ret += "        " + hash_type->get_simple_name() + " val = 0;\n";
+        ret += "        switch (check_types [i]) {\n";
+        for (int type_id = 0; type_id < Type::IntegerTypeID::MAX_INT_ID; ++type_id) {
+            if (!used_types.at(type_id))
+                continue;
+            std::string type_name = IntegerType::init((Type::IntegerTypeID) type_id)->get_simple_name();
+            ret += "            case " + std::to_string(type_id) + ": val = *(const volatile " + type_name + " *) check_addrs [i]; break;\n";
+        }
+        if (bit_field_num != 0)
+            ret += "            default: val = bit_field_vals [bit_field_idx++]; break;\n";
+        ret += "        }\n";
+        if (out_profile == C)
+            ret += "        hash(&seed, val);\n";
+        else
+            ret += "        hash(seed, val);\n";
+        ret += "    }\n";
+    }
 
     ret += "    return seed;\n";
     ret += "}";
-    write_file("check.cpp", ret);
+
+    if (emit_checkpoints) {
+        ret += "\n\n";
+        std::string checkpoint_num = std::to_string(checkpoints.size());
+        if (checkpoints.size() != 0) {
+            ret += "unsigned long long int checkpoint_vals [" + checkpoint_num + "];\n\n";
+        }
+        ret += "long long int first_failed_checkpoint () {\n";
+        if (checkpoints.size() != 0) {
+            ret += "    static const unsigned long long int checkpoint_expected [" + checkpoint_num + "] = {\n";
+            for (auto i : checkpoints)
+                ret += "        " + std::to_string(i->get_expected_val()) + "ULL,\n";
+            ret += "    };\n";
+            ret += "    for (unsigned int i = 0; i < " + checkpoint_num + "; ++i)\n";
+            ret += "        if (checkpoint_vals [i] != checkpoint_expected [i])\n";
+            ret += "            return i;\n";
+        }
+        ret += "    return -1;\n";
+        ret += "}";
+    }
+    write_file("check" + test_suffix + get_src_ext(), ret);
     return ret;
 }
 
 std::string Master::emit_main () {
     std::string ret = "";
-    ret += "#include \"init.h\"\n\n";
-    ret += "extern void init ();\n";
-    ret += "extern void foo ();\n";
-    ret += "extern unsigned long long int checksum ();\n\n";
+    if (out_profile == C)
+        ret += "#include <stdio.h>\n";
+    else if (out_profile == CXX_LIGHT)
+        ret += "#include <cstdio>\n";
+    ret += "#include \"init" + test_suffix + ".h\"\n\n";
+    ret += "extern void init" + test_suffix + " ();\n";
+    ret += "extern void foo" + test_suffix + " ();\n";
+    ret += "extern unsigned long long int checksum" + test_suffix + " ();\n";
+    if (emit_checkpoints)
+        ret += "extern long long int first_failed_checkpoint ();\n";
+    ret += "\n";
     ret += "int main () {\n";
-    ret += "    init ();\n";
-    ret += "    foo ();\n";
-    ret += "    std::cout << checksum () << std::endl;\n";
+    ret += "    init" + test_suffix + " ();\n";
+    ret += "    foo" + test_suffix + " ();\n";
+    ret += "    unsigned long long int res = checksum" + test_suffix + " ();\n";
+    if (out_profile == CXX)
+        ret += "    std::cout << res << std::endl;\n";
+    else
+        ret += "    printf(\"%llu\\n\", res);\n";
+    if (emit_checkpoints) {
+        ret += "    long long int failed_checkpoint = first_failed_checkpoint ();\n";
+        ret += "    if (failed_checkpoint != -1)\n";
+        if (out_profile == CXX)
+            ret += "        std::cerr << \"First failed checkpoint: \" << failed_checkpoint << std::endl;\n";
+        else
+            ret += "        fprintf(stderr, \"First failed checkpoint: %lld\\n\", failed_checkpoint);\n";
+    }
+    if (self_check) {
+        ret += "    if (res != " + std::to_string(expected_checksum) + "ULL";
+        if (emit_checkpoints)
+            ret += " || failed_checkpoint != -1";
+        ret += ")\n";
+        ret += "        return " + std::to_string(self_check_fail_code) + ";\n";
+    }
     ret += "    return 0;\n";
     ret += "}";
-    write_file("driver.cpp", ret);
+    write_file("driver" + get_src_ext(), ret);
     return ret;
 }
 
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <fstream>
 
+#include "archive.h"
 #include "gen_policy.h"
 #include "sym_table.h"
 #include "stmt.h"
@@ -29,17 +30,71 @@ namespace rl {
 
 class Master {
     public:
-        Master (std::string _out_folder);
+        // Output profiles:
+        // CXX - default C++ output,
+        // CXX_LIGHT - C++ output, which includes only <cstdint> in init.h and uses printf,
+        // C - C99-compatible output in .c files
+        enum OutProfile {
+            CXX, CXX_LIGHT, C, MAX_OUT_PROFILE
+        };
+
+        Master (std::string _out_folder, OutProfile _out_profile = CXX);
         void generate ();
+        // Generates new body of foo () for external variables of generated test (member of test family).
+        // Execution of every body starts from initial values, so its checksum doesn't depend on other bodies.
+        void generate_body ();
+        // Recomputes all values after modification of program. Returns false if executed code has UB.
+        bool repropagate ();
+        // Resets values of external variables to the state before the execution of foo ()
+        void restore_init_values ();
+        std::shared_ptr<ScopeStmt> get_program () { return program; }
+        GenPolicy* get_gen_policy () { return &gen_policy; }
+        std::shared_ptr<SymbolTable> get_extern_inp_sym_table () { return extern_inp_sym_table; }
+        std::shared_ptr<SymbolTable> get_extern_mix_sym_table () { return extern_mix_sym_table; }
+        std::shared_ptr<SymbolTable> get_extern_out_sym_table () { return extern_out_sym_table; }
+        // Binary IR file (see serializer.h). Loaded IR replaces generated one and is re-propagated.
+        void save (std::string file_name);
+        void load (std::string file_name);
+        void set_out_folder (std::string _out_folder) { out_folder = _out_folder; }
+        // Emits all files of the test
+        void emit ();
+        // Emits only files, which depend on the body of foo (), if declarations of the test are the same
+        void emit_variant ();
         std::string emit_func ();
         std::string emit_init ();
         std::string emit_decl ();
         std::string emit_hash ();
         std::string emit_check ();
         std::string emit_main ();
+        std::string emit_expected_checksum ();
+
+        // Self-checking driver compares checksum with expected one and returns self_check_fail_code on mismatch
+        void set_self_check (bool _self_check) { self_check = _self_check; }
+        static const int self_check_fail_code = 3;
+        // In checkpoint mode emit () also emits variant of the test to checkpoint_folder, where every executed ExprStmt
+        // stores assigned value, which is compared with expected one on exit. It is used for triage of the test.
+        void set_use_checkpoints (bool _use_checkpoints) { use_checkpoints = _use_checkpoints; }
+        // Suffix is added to names of files and functions of the test, so several tests can be linked together
+        void set_test_suffix (std::string _test_suffix) { test_suffix = _test_suffix; }
+        uint64_t get_expected_checksum () { return expected_checksum; }
+
+        // If archive is set, all emitted files are added to it instead of writing them to output folder
+        static void set_archive (std::shared_ptr<Archive> _archive) { archive = _archive; }
+        static void write_file (std::string folder, std::string of_name, std::string data);
 
     private:
-        void write_file (std::string of_name, std::string data);
+        static thread_local std::shared_ptr<Archive> archive;
+
+        // Files of checkpoint variant are written to checkpoint_folder (or have it as prefix in archive)
+        void write_file (std::string of_name, std::string data) {
+            write_file(out_folder, (emit_checkpoints ? std::string(checkpoint_folder) + "/" : "") + of_name, data);
+        }
+        void emit_checkpoint_variant ();
+        std::string get_src_ext () { return out_profile == C ? ".c" : ".cpp"; }
+        // Restricts generation policy for output profile
+        void set_profile_gen_policy ();
+        std::vector<std::shared_ptr<Expr>> form_check_exprs ();
+        uint64_t calc_expected_checksum ();
 
         GenPolicy gen_policy;
         std::shared_ptr<ScopeStmt> program;
@@ -47,6 +102,15 @@ class Master {
         std::shared_ptr<SymbolTable> extern_mix_sym_table;
         std::shared_ptr<SymbolTable> extern_out_sym_table;
         std::string out_folder;
+        OutProfile out_profile;
+        bool self_check;
+        uint64_t expected_checksum;
+        bool use_checkpoints;
+        bool emit_checkpoints;
+        static constexpr const char* checkpoint_folder = "checkpoints";
+        std::vector<std::shared_ptr<ExprStmt>> checkpoints;
+        std::vector<std::shared_ptr<MemberExpr>> out_avail_members;
+        std::string test_suffix;
 };
 }
 
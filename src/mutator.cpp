@@ -0,0 +1,129 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include <sys/stat.h>
+
+#include "mutator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+Mutator::Mutator (Master& _master, std::string _out_folder, int _num) :
+                  master(_master), out_folder(_out_folder), num(_num), mutated_scope(NULL), mutated_idx(0), orig_stmt(NULL) {}
+
+// Chooses random statement and re-generates it. Statements before it are executed to get values of variables,
+// which are used by generator to avoid UB. Returns false if mutant isn't valid (mutation is reverted in this case).
+bool Mutator::form_mutant () {
+    GenPolicy gen_policy = *(master.get_gen_policy());
+    gen_policy.set_allow_new_out_vars(false);
+    Context ctx_base (gen_policy, NULL, Node::NodeID::MAX_STMT_ID, true);
+    ctx_base.set_extern_inp_sym_table(master.get_extern_inp_sym_table());
+    ctx_base.set_extern_mix_sym_table(master.get_extern_mix_sym_table());
+    ctx_base.set_extern_out_sym_table(master.get_extern_out_sym_table());
+    std::shared_ptr<Context> root_ctx = std::make_shared<Context>(ctx_base);
+    // All visible local variables are gathered in the root context
+    std::shared_ptr<SymbolTable> local_sym_table = root_ctx->get_local_sym_table();
+
+    master.restore_init_values();
+    std::shared_ptr<Context> ctx = root_ctx;
+    std::shared_ptr<ScopeStmt> scope = master.get_program();
+    uint64_t idx = 0;
+    while (true) {
+        // Declarations are used by following statements, so they are never mutated
+        std::vector<uint64_t> candidates;
+        for (uint64_t i = 0; i < scope->get_scope().size(); ++i)
+            if (scope->get_scope().at(i)->get_id() != Node::NodeID::DECL)
+                candidates.push_back(i);
+        if (candidates.size() == 0)
+            return false;
+        idx = candidates.at(rand_val_gen->get_rand_value<uint64_t>(0, candidates.size() - 1));
+
+        for (uint64_t i = 0; i < idx; ++i) {
+            std::shared_ptr<Stmt> stmt = scope->get_scope().at(i);
+            stmt->repropagate_value(ctx->get_taken());
+            if (stmt->get_id() == Node::NodeID::DECL)
+                local_sym_table->add_variable(std::static_pointer_cast<ScalarVariable>(std::static_pointer_cast<DeclStmt>(stmt)->get_data()));
+        }
+
+        // Mutation can go deeper into one of the branches
+        std::shared_ptr<Stmt> stmt = scope->get_scope().at(idx);
+        if (stmt->get_id() != Node::NodeID::IF || rand_val_gen->get_rand_value<int>(0, 1))
+            break;
+        std::shared_ptr<IfStmt> if_stmt = std::static_pointer_cast<IfStmt>(stmt);
+        if_stmt->get_cond()->repropagate_value();
+        bool cond_taken = IfStmt::count_if_taken(if_stmt->get_cond());
+        bool use_else = if_stmt->get_else_branch() != NULL && rand_val_gen->get_rand_value<int>(0, 1);
+        std::shared_ptr<Context> if_ctx = std::make_shared<Context>(gen_policy, ctx, Node::NodeID::IF, true);
+        ctx = std::make_shared<Context>(gen_policy, if_ctx, Node::NodeID::SCOPE, use_else ? !cond_taken : cond_taken);
+        scope = use_else ? if_stmt->get_else_branch() : if_stmt->get_if_branch();
+    }
+
+    mutated_scope = scope;
+    mutated_idx = idx;
+    orig_stmt = scope->get_scope().at(idx);
+    orig_out_avail_members = master.get_extern_out_sym_table()->get_avail_members();
+    uint64_t out_var_num = master.get_extern_out_sym_table()->get_variables().size();
+    std::vector<std::shared_ptr<Expr>> inp = ScopeStmt::form_inp_from_ctx(ctx);
+    if (orig_stmt->get_id() == Node::NodeID::EXPR) {
+        std::shared_ptr<Expr> expr = std::static_pointer_cast<ExprStmt>(orig_stmt)->get_expr();
+        if (expr->get_id() != Node::NodeID::ASSIGN)
+            return false;
+        scope->get_scope().at(idx) = ExprStmt::generate(ctx, inp, std::static_pointer_cast<AssignExpr>(expr)->get_to());
+    }
+    else
+        scope->get_scope().at(idx) = IfStmt::generate(std::make_shared<Context>(gen_policy, ctx, Node::NodeID::IF, true), inp);
+
+    // New statement is correct, but following statements can get UB with changed values
+    bool new_out_vars = master.get_extern_out_sym_table()->get_variables().size() != out_var_num;
+    if (new_out_vars)
+        master.get_extern_out_sym_table()->get_variables().resize(out_var_num);
+    if (new_out_vars || !master.repropagate()) {
+        revert();
+        return false;
+    }
+    return true;
+}
+
+// Values are re-propagated by the next mutation, so only the structure and available members are restored
+void Mutator::revert () {
+    mutated_scope->get_scope().at(mutated_idx) = orig_stmt;
+    master.get_extern_out_sym_table()->get_avail_members() = orig_out_avail_members;
+}
+
+void Mutator::mutate () {
+    for (int i = 0; i < num; ++i) {
+        int attempt = 0;
+        while (attempt < max_attempts && !form_mutant())
+            attempt++;
+        if (attempt == max_attempts) {
+            std::cerr << "Mutator: can't form mutant " << i << " in " << max_attempts << " attempts" << std::endl;
+            continue;
+        }
+        std::string folder = out_folder + "/mutant_" + std::to_string(i);
+        mkdir(folder.c_str(), 0755);
+        master.set_out_folder(folder);
+        master.emit_variant();
+        revert();
+    }
+    master.set_out_folder(out_folder);
+    if (!master.repropagate()) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't restore base test in Mutator::mutate" << std::endl;
+        exit(-1);
+    }
+}
@@ -0,0 +1,51 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "master.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rl {
+
+// Mutator derives variants of generated test. Every mutant re-generates one random statement of foo ()
+// (assignment or whole if statement) in the state of the program right before it, so it is free of UB.
+// Mutants don't create new external variables, so init, hash and check files of the base test are reused
+// and only files, which depend on foo (), are emitted to <out_folder>/mutant_<num>.
+class Mutator {
+    public:
+        Mutator (Master& _master, std::string _out_folder, int _num);
+        void mutate ();
+
+    private:
+        static const int max_attempts = 100;
+
+        bool form_mutant ();
+        void revert ();
+
+        Master& master;
+        std::string out_folder;
+        int num;
+        // Last applied mutation
+        std::shared_ptr<ScopeStmt> mutated_scope;
+        uint64_t mutated_idx;
+        std::shared_ptr<Stmt> orig_stmt;
+        // New statement takes output struct members, which are available before the mutation
+        std::vector<std::shared_ptr<MemberExpr>> orig_out_avail_members;
+};
+}
@@ -0,0 +1,308 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "reducer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+// Constants and leaves can't be simplified any further
+static bool is_simple_expr (std::shared_ptr<Expr> expr) {
+    switch (expr->get_id()) {
+        case Node::NodeID::CONST:
+        case Node::NodeID::VAR_USE:
+        case Node::NodeID::MEMBER:
+            return true;
+        case Node::NodeID::TYPE_CAST:
+            return expr->get_operands().at(0)->get_id() == Node::NodeID::CONST;
+        default:
+            return false;
+    }
+}
+
+// Replacement for expression, which has the same type and current value
+static std::shared_ptr<Expr> form_const_expr (std::shared_ptr<Expr> expr) {
+    std::shared_ptr<ScalarVariable> scalar_val = std::static_pointer_cast<ScalarVariable>(expr->get_value());
+    std::shared_ptr<ConstExpr> const_expr = std::make_shared<ConstExpr>(scalar_val->get_cur_value());
+    return std::make_shared<TypeCastExpr>(const_expr, IntegerType::init(scalar_val->get_type()->get_int_type_id()));
+}
+
+static int remove_file (const char* path, const struct stat* sb, int type_flag, struct FTW* ftw_buf) {
+    return remove(path);
+}
+
+Reducer::Reducer (Master& _master, std::string _out_folder, std::string _script, int _jobs) :
+                  master(_master), out_folder(_out_folder), script(_script), jobs(_jobs) {
+    // Script is run in candidate folder, so relative path to it should be resolved
+    char script_path [PATH_MAX];
+    if (access(script.c_str(), F_OK) == 0 && realpath(script.c_str(), script_path) != NULL)
+        script = std::string(script_path);
+    if (jobs < 1)
+        jobs = 1;
+}
+
+std::string Reducer::get_candidate_folder (int num) {
+    std::string ret = out_folder + "/reduce_" + std::to_string(num);
+    mkdir(ret.c_str(), 0755);
+    return ret;
+}
+
+std::vector<bool> Reducer::run_script (int candidate_num) {
+    std::vector<pid_t> pids;
+    for (int i = 0; i < candidate_num; ++i) {
+        std::string folder = get_candidate_folder(i);
+        pid_t pid = fork();
+        if (pid == 0) {
+            int dev_null = open("/dev/null", O_WRONLY);
+            dup2(dev_null, STDOUT_FILENO);
+            dup2(dev_null, STDERR_FILENO);
+            if (chdir(folder.c_str()) != 0)
+                _exit(127);
+            execl("/bin/sh", "sh", "-c", script.c_str(), (char*) NULL);
+            _exit(127);
+        }
+        if (pid < 0) {
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't fork in Reducer::run_script" << std::endl;
+            exit(-1);
+        }
+        pids.push_back(pid);
+    }
+    std::vector<bool> ret;
+    for (auto i : pids) {
+        int status = 0;
+        waitpid(i, &status, 0);
+        ret.push_back(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    return ret;
+}
+
+void Reducer::form_stmt_candidates (std::shared_ptr<ScopeStmt> scope, std::vector<Candidate>& candidates) {
+    // Local variables can be used in the rest of the scope, so declarations are never removed
+    std::vector<uint64_t> positions;
+    for (uint64_t i = 0; i < scope->get_scope().size(); ++i)
+        if (scope->get_scope().at(i)->get_id() != Node::NodeID::DECL)
+            positions.push_back(i);
+
+    // Large chunks go first, so big parts of the test are removed quickly
+    for (uint64_t chunk = positions.size(); chunk > 0; chunk /= 2) {
+        for (uint64_t start = 0; start < positions.size(); start += chunk) {
+            std::vector<uint64_t> chunk_pos (positions.begin() + start, positions.begin() + std::min(start + chunk, (uint64_t) positions.size()));
+            std::shared_ptr<std::vector<std::shared_ptr<Stmt>>> removed = std::make_shared<std::vector<std::shared_ptr<Stmt>>>();
+            Candidate candidate;
+            candidate.apply = [scope, chunk_pos, removed] () {
+                removed->clear();
+                for (auto i : chunk_pos)
+                    removed->push_back(scope->get_scope().at(i));
+                for (auto i = chunk_pos.rbegin(); i != chunk_pos.rend(); ++i)
+                    scope->get_scope().erase(scope->get_scope().begin() + *i);
+            };
+            candidate.revert = [scope, chunk_pos, removed] () {
+                for (uint64_t i = 0; i < chunk_pos.size(); ++i)
+                    scope->get_scope().insert(scope->get_scope().begin() + chunk_pos.at(i), removed->at(i));
+            };
+            candidates.push_back(candidate);
+        }
+    }
+
+    for (auto i : scope->get_scope()) {
+        if (i->get_id() == Node::NodeID::SCOPE)
+            form_stmt_candidates(std::static_pointer_cast<ScopeStmt>(i), candidates);
+        else if (i->get_id() == Node::NodeID::IF) {
+            std::shared_ptr<IfStmt> if_stmt = std::static_pointer_cast<IfStmt>(i);
+            form_stmt_candidates(if_stmt->get_if_branch(), candidates);
+            if (if_stmt->get_else_branch() != NULL)
+                form_stmt_candidates(if_stmt->get_else_branch(), candidates);
+        }
+    }
+}
+
+void Reducer::form_if_candidates (std::shared_ptr<ScopeStmt> scope, std::vector<Candidate>& candidates) {
+    for (uint64_t i = 0; i < scope->get_scope().size(); ++i) {
+        std::shared_ptr<Stmt> stmt = scope->get_scope().at(i);
+        if (stmt->get_id() == Node::NodeID::SCOPE) {
+            form_if_candidates(std::static_pointer_cast<ScopeStmt>(stmt), candidates);
+            continue;
+        }
+        if (stmt->get_id() != Node::NodeID::IF)
+            continue;
+
+        std::shared_ptr<IfStmt> if_stmt = std::static_pointer_cast<IfStmt>(stmt);
+        // If statement is replaced with one of its branches. Branch is kept as a scope, so its declarations stay local.
+        for (auto branch : {if_stmt->get_if_branch(), if_stmt->get_else_branch()}) {
+            if (branch == NULL)
+                continue;
+            Candidate candidate;
+            candidate.apply = [scope, i, branch] () { scope->get_scope().at(i) = branch; };
+            candidate.revert = [scope, i, if_stmt] () { scope->get_scope().at(i) = if_stmt; };
+            candidates.push_back(candidate);
+        }
+        std::shared_ptr<ScopeStmt> else_branch = if_stmt->get_else_branch();
+        if (else_branch != NULL) {
+            Candidate candidate;
+            candidate.apply = [if_stmt] () { if_stmt->set_else_branch(NULL); };
+            candidate.revert = [if_stmt, else_branch] () { if_stmt->set_else_branch(else_branch); };
+            candidates.push_back(candidate);
+        }
+
+        form_if_candidates(if_stmt->get_if_branch(), candidates);
+        if (else_branch != NULL)
+            form_if_candidates(else_branch, candidates);
+    }
+}
+
+void Reducer::form_operand_candidates (std::shared_ptr<Expr> expr, std::vector<Candidate>& candidates) {
+    std::vector<std::shared_ptr<Expr>> operands = expr->get_operands();
+    for (uint64_t i = 0; i < operands.size(); ++i) {
+        std::shared_ptr<Expr> operand = operands.at(i);
+        if (is_simple_expr(operand))
+            continue;
+        std::shared_ptr<Expr> const_expr = form_const_expr(operand);
+        Candidate candidate;
+        candidate.apply = [expr, i, const_expr] () { expr->set_operand(i, const_expr); };
+        candidate.revert = [expr, i, operand] () { expr->set_operand(i, operand); };
+        candidates.push_back(candidate);
+        form_operand_candidates(operand, candidates);
+    }
+}
+
+void Reducer::form_expr_candidates (std::shared_ptr<Stmt> stmt, std::vector<Candidate>& candidates) {
+    switch (stmt->get_id()) {
+        case Node::NodeID::EXPR:
+            form_operand_candidates(std::static_pointer_cast<ExprStmt>(stmt)->get_expr(), candidates);
+            break;
+        case Node::NodeID::DECL: {
+            std::shared_ptr<DeclStmt> decl_stmt = std::static_pointer_cast<DeclStmt>(stmt);
+            std::shared_ptr<Expr> init = decl_stmt->get_init();
+            if (init == NULL || is_simple_expr(init))
+                break;
+            std::shared_ptr<Expr> const_expr = form_const_expr(init);
+            Candidate candidate;
+            candidate.apply = [decl_stmt, const_expr] () { decl_stmt->set_init(const_expr); };
+            candidate.revert = [decl_stmt, init] () { decl_stmt->set_init(init); };
+            candidates.push_back(candidate);
+            form_operand_candidates(init, candidates);
+            break;
+        }
+        case Node::NodeID::IF: {
+            std::shared_ptr<IfStmt> if_stmt = std::static_pointer_cast<IfStmt>(stmt);
+            std::shared_ptr<Expr> cond = if_stmt->get_cond();
+            if (!is_simple_expr(cond)) {
+                std::shared_ptr<Expr> const_expr = form_const_expr(cond);
+                Candidate candidate;
+                candidate.apply = [if_stmt, const_expr] () { if_stmt->set_cond(const_expr); };
+                candidate.revert = [if_stmt, cond] () { if_stmt->set_cond(cond); };
+                candidates.push_back(candidate);
+                form_operand_candidates(cond, candidates);
+            }
+            form_expr_candidates(if_stmt->get_if_branch(), candidates);
+            if (if_stmt->get_else_branch() != NULL)
+                form_expr_candidates(if_stmt->get_else_branch(), candidates);
+            break;
+        }
+        case Node::NodeID::SCOPE:
+            for (auto i : std::static_pointer_cast<ScopeStmt>(stmt)->get_scope())
+                form_expr_candidates(i, candidates);
+            break;
+        default:
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad stmt in Reducer::form_expr_candidates" << std::endl;
+            exit(-1);
+    }
+}
+
+// Candidates are ordered from the most to the least profitable
+std::vector<Reducer::Candidate> Reducer::form_candidates () {
+    std::vector<Candidate> ret;
+    form_stmt_candidates(master.get_program(), ret);
+    form_if_candidates(master.get_program(), ret);
+    form_expr_candidates(master.get_program(), ret);
+    return ret;
+}
+
+void Reducer::reduce () {
+    if (!master.repropagate()) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": initial test has UB in Reducer::reduce" << std::endl;
+        exit(-1);
+    }
+    master.set_out_folder(get_candidate_folder(0));
+    master.emit();
+    if (!run_script(1).at(0)) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": initial test isn't interesting in Reducer::reduce" << std::endl;
+        exit(-1);
+    }
+
+    uint64_t tested_num = 0;
+    uint64_t applied_num = 0;
+    uint64_t start = 0;
+    bool progress = false;
+    while (true) {
+        // Emission resets values of variables, but replacement constants are taken from current values
+        master.repropagate();
+        std::vector<Candidate> candidates = form_candidates();
+        if (start >= candidates.size()) {
+            if (!progress)
+                break;
+            progress = false;
+            start = 0;
+            continue;
+        }
+
+        // Candidates with UB are skipped, other ones are tested in parallel
+        std::vector<uint64_t> batch;
+        uint64_t idx = start;
+        for (; idx < candidates.size() && batch.size() < (uint64_t) jobs; ++idx) {
+            candidates.at(idx).apply();
+            if (master.repropagate()) {
+                master.set_out_folder(get_candidate_folder(batch.size()));
+                master.emit();
+                batch.push_back(idx);
+            }
+            candidates.at(idx).revert();
+        }
+        start = idx;
+        tested_num += batch.size();
+
+        // The first interesting candidate is chosen, so result doesn't depend on number of jobs
+        std::vector<bool> interesting = run_script(batch.size());
+        for (uint64_t i = 0; i < batch.size(); ++i) {
+            if (interesting.at(i)) {
+                candidates.at(batch.at(i)).apply();
+                applied_num++;
+                progress = true;
+                start = batch.at(i);
+                std::cerr << "Reducer: " << applied_num << " changes applied, " << tested_num << " candidates tested" << std::endl;
+                break;
+            }
+        }
+    }
+
+    master.repropagate();
+    master.set_out_folder(out_folder);
+    master.emit();
+    for (int i = 0; i < jobs; ++i)
+        nftw(get_candidate_folder(i).c_str(), remove_file, 16, FTW_DEPTH | FTW_PHYS);
+}
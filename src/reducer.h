@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <functional>
+
+#include "master.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rl {
+
+// Reducer simplifies generated test on IR level while user-provided script considers it interesting.
+// Script is run in the directory with candidate test and should return 0 for interesting tests.
+// Every candidate is re-propagated, so it is free of UB and has correct expected checksum.
+class Reducer {
+    public:
+        Reducer (Master& _master, std::string _out_folder, std::string _script, int _jobs);
+        void reduce ();
+
+    private:
+        // Modification of IR, which can be reverted
+        struct Candidate {
+            std::function<void()> apply;
+            std::function<void()> revert;
+        };
+
+        std::vector<Candidate> form_candidates ();
+        void form_stmt_candidates (std::shared_ptr<ScopeStmt> scope, std::vector<Candidate>& candidates);
+        void form_if_candidates (std::shared_ptr<ScopeStmt> scope, std::vector<Candidate>& candidates);
+        void form_expr_candidates (std::shared_ptr<Stmt> stmt, std::vector<Candidate>& candidates);
+        void form_operand_candidates (std::shared_ptr<Expr> expr, std::vector<Candidate>& candidates);
+        std::string get_candidate_folder (int num);
+        std::vector<bool> run_script (int candidate_num);
+
+        Master& master;
+        std::string out_folder;
+        std::string script;
+        int jobs;
+};
+}
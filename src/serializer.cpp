@@ -0,0 +1,583 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "serializer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+static ir_file::ValRecord form_val_record (AtomicType::ScalarTypedVal val) {
+    ir_file::ValRecord ret;
+    ret.val = val.val.ullint_val;
+    ret.int_type_id = val.get_int_type_id();
+    ret.ub = val.get_ub();
+    return ret;
+}
+
+static AtomicType::ScalarTypedVal form_val (ir_file::ValRecord rec) {
+    AtomicType::ScalarTypedVal ret ((Type::IntegerTypeID) rec.int_type_id, (UB) rec.ub);
+    ret.val.ullint_val = rec.val;
+    return ret;
+}
+
+// Operand of the same type, which can't cause UB or implicit conversion in constructor of expression.
+// It is replaced with real operand right after construction.
+static std::shared_ptr<Expr> form_placeholder (std::shared_ptr<Expr> operand) {
+    AtomicType::ScalarTypedVal one (Type::IntegerTypeID::ULLINT);
+    one.val.ullint_val = 1;
+    return std::make_shared<ConstExpr>(one.cast_type(operand->get_value()->get_type()->get_int_type_id()));
+}
+
+static uint64_t align_offset (uint64_t offset) {
+    return (offset + 7) & ~((uint64_t) 7);
+}
+
+uint32_t IRWriter::add_string (std::string str) {
+    uint32_t ret = string_pool.size();
+    string_pool += str;
+    string_pool.push_back('\0');
+    return ret;
+}
+
+ir_file::List IRWriter::add_list (std::vector<uint32_t> list) {
+    ir_file::List ret;
+    ret.offset = index_pool.size();
+    ret.num = list.size();
+    index_pool.insert(index_pool.end(), list.begin(), list.end());
+    return ret;
+}
+
+uint32_t IRWriter::add_type (std::shared_ptr<Type> type) {
+    auto search = type_idx.find(type.get());
+    if (search != type_idx.end())
+        return search->second;
+
+    ir_file::TypeRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type_id = type->get_type_id();
+    rec.int_type_id = type->get_int_type_id();
+    rec.is_bit_field = type->get_is_bit_field();
+    rec.modifier = type->get_modifier();
+    rec.is_static = type->get_is_static();
+    rec.name = add_string(type->get_simple_name());
+    rec.align = type->get_align();
+    if (type->get_is_bit_field())
+        rec.bit_field_width = std::static_pointer_cast<BitField>(type)->get_bit_field_width();
+    if (type->is_struct_type()) {
+        std::shared_ptr<StructType> struct_type = std::static_pointer_cast<StructType>(type);
+        rec.nest_depth = struct_type->get_nest_depth();
+        std::vector<uint32_t> members;
+        for (uint64_t i = 0; i < struct_type->get_num_of_members(); ++i)
+            members.push_back(add_struct_member(struct_type->get_member(i)));
+        std::vector<uint32_t> shadow_members;
+        for (uint64_t i = 0; i < struct_type->get_num_of_shadow_members(); ++i)
+            shadow_members.push_back(add_struct_member(struct_type->get_shadow_member(i)));
+        rec.members = add_list(members);
+        rec.shadow_members = add_list(shadow_members);
+    }
+    uint32_t ret = types.size();
+    types.push_back(rec);
+    type_idx[type.get()] = ret;
+    return ret;
+}
+
+uint32_t IRWriter::add_struct_member (std::shared_ptr<StructType::StructMember> member) {
+    auto search = struct_member_idx.find(member.get());
+    if (search != struct_member_idx.end())
+        return search->second;
+
+    ir_file::StructMemberRecord rec;
+    rec.type = add_type(member->get_type());
+    rec.name = add_string(member->get_name());
+    uint32_t ret = struct_members.size();
+    struct_members.push_back(rec);
+    struct_member_idx[member.get()] = ret;
+    return ret;
+}
+
+uint32_t IRWriter::add_data (std::shared_ptr<Data> _data, uint32_t owner, uint32_t member_num) {
+    auto search = data_idx.find(_data.get());
+    if (search != data_idx.end())
+        return search->second;
+
+    ir_file::DataRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.class_id = _data->get_class_id();
+    rec.type = add_type(_data->get_type());
+    rec.name = add_string(_data->get_name());
+    rec.owner = owner;
+    rec.member_num = member_num;
+    if (_data->get_class_id() == Data::VarClassID::VAR) {
+        std::shared_ptr<ScalarVariable> scalar_var = std::static_pointer_cast<ScalarVariable>(_data);
+        rec.min = form_val_record(scalar_var->get_min());
+        rec.max = form_val_record(scalar_var->get_max());
+        rec.init_val = form_val_record(scalar_var->get_init_value());
+        rec.cur_val = form_val_record(scalar_var->get_cur_value());
+    }
+    uint32_t ret = data.size();
+    data.push_back(rec);
+    data_idx[_data.get()] = ret;
+
+    // Members refer to their owner, so they are added after it
+    if (_data->get_class_id() == Data::VarClassID::STRUCT) {
+        std::shared_ptr<Struct> struct_var = std::static_pointer_cast<Struct>(_data);
+        for (uint64_t i = 0; i < struct_var->get_num_of_members(); ++i)
+            add_data(struct_var->get_member(i), ret, i);
+    }
+    return ret;
+}
+
+uint32_t IRWriter::add_expr (std::shared_ptr<Expr> expr) {
+    auto search = expr_idx.find(expr.get());
+    if (search != expr_idx.end())
+        return search->second;
+
+    ir_file::ExprRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = expr->get_id();
+    rec.ref = ir_file::none;
+    rec.args[0] = rec.args[1] = ir_file::none;
+    std::vector<std::shared_ptr<Expr>> operands = expr->get_operands();
+    switch (expr->get_id()) {
+        case Node::NodeID::VAR_USE:
+            rec.ref = add_data(std::static_pointer_cast<VarUseExpr>(expr)->get_var());
+            break;
+        case Node::NodeID::CONST:
+            rec.val = form_val_record(std::static_pointer_cast<ScalarVariable>(expr->get_value())->get_cur_value());
+            break;
+        case Node::NodeID::TYPE_CAST:
+            rec.op = std::static_pointer_cast<TypeCastExpr>(expr)->get_is_implicit();
+            rec.ref = add_type(std::static_pointer_cast<TypeCastExpr>(expr)->get_to_type());
+            rec.args[0] = add_expr(operands.at(0));
+            break;
+        case Node::NodeID::UNARY:
+            rec.op = std::static_pointer_cast<UnaryExpr>(expr)->get_op();
+            rec.args[0] = add_expr(operands.at(0));
+            break;
+        case Node::NodeID::BINARY:
+            rec.op = std::static_pointer_cast<BinaryExpr>(expr)->get_op();
+            rec.args[0] = add_expr(operands.at(0));
+            rec.args[1] = add_expr(operands.at(1));
+            break;
+        case Node::NodeID::ASSIGN:
+            rec.op = std::static_pointer_cast<AssignExpr>(expr)->get_taken();
+            rec.args[0] = add_expr(std::static_pointer_cast<AssignExpr>(expr)->get_to());
+            rec.args[1] = add_expr(operands.at(0));
+            break;
+        case Node::NodeID::MEMBER: {
+            std::shared_ptr<MemberExpr> member_expr = std::static_pointer_cast<MemberExpr>(expr);
+            rec.op = member_expr->get_identifier();
+            if (member_expr->get_struct_var() != NULL)
+                rec.ref = add_data(member_expr->get_struct_var());
+            else
+                rec.args[0] = add_expr(member_expr->get_member_expr());
+            break;
+        }
+        default:
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": unsupported expr in IRWriter::add_expr" << std::endl;
+            exit(-1);
+    }
+    uint32_t ret = exprs.size();
+    exprs.push_back(rec);
+    expr_idx[expr.get()] = ret;
+    return ret;
+}
+
+uint32_t IRWriter::add_stmt (std::shared_ptr<Stmt> stmt) {
+    ir_file::StmtRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = stmt->get_id();
+    rec.data = rec.expr = ir_file::none;
+    rec.branches[0] = rec.branches[1] = ir_file::none;
+    switch (stmt->get_id()) {
+        case Node::NodeID::DECL: {
+            std::shared_ptr<DeclStmt> decl_stmt = std::static_pointer_cast<DeclStmt>(stmt);
+            rec.is_extern = decl_stmt->get_is_extern();
+            rec.data = add_data(decl_stmt->get_data());
+            if (decl_stmt->get_init() != NULL)
+                rec.expr = add_expr(decl_stmt->get_init());
+            break;
+        }
+        case Node::NodeID::EXPR:
+            rec.expr = add_expr(std::static_pointer_cast<ExprStmt>(stmt)->get_expr());
+            break;
+        case Node::NodeID::SCOPE: {
+            std::vector<uint32_t> scope;
+            for (auto i : std::static_pointer_cast<ScopeStmt>(stmt)->get_scope())
+                scope.push_back(add_stmt(i));
+            rec.stmts = add_list(scope);
+            break;
+        }
+        case Node::NodeID::IF: {
+            std::shared_ptr<IfStmt> if_stmt = std::static_pointer_cast<IfStmt>(stmt);
+            rec.expr = add_expr(if_stmt->get_cond());
+            rec.branches[0] = add_stmt(if_stmt->get_if_branch());
+            if (if_stmt->get_else_branch() != NULL)
+                rec.branches[1] = add_stmt(if_stmt->get_else_branch());
+            break;
+        }
+        default:
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": unsupported stmt in IRWriter::add_stmt" << std::endl;
+            exit(-1);
+    }
+    uint32_t ret = stmts.size();
+    stmts.push_back(rec);
+    return ret;
+}
+
+ir_file::SymTableRecord IRWriter::add_sym_table (std::shared_ptr<SymbolTable> sym_table) {
+    ir_file::SymTableRecord rec;
+    std::vector<uint32_t> list;
+    for (auto i : sym_table->get_variables())
+        list.push_back(add_data(i));
+    rec.variables = add_list(list);
+    list.clear();
+    for (auto i : sym_table->get_struct_types())
+        list.push_back(add_type(i));
+    rec.struct_types = add_list(list);
+    list.clear();
+    for (auto i : sym_table->get_structs())
+        list.push_back(add_data(i));
+    rec.structs = add_list(list);
+    list.clear();
+    for (auto i : sym_table->get_avail_members())
+        list.push_back(add_expr(i));
+    rec.avail_members = add_list(list);
+    list.clear();
+    for (auto i : sym_table->get_avail_const_members())
+        list.push_back(add_expr(i));
+    rec.avail_const_members = add_list(list);
+    return rec;
+}
+
+void IRWriter::write (std::string file_name, IRImage image) {
+    std::vector<ir_file::SymTableRecord> sym_tables;
+    for (auto i : {image.extern_inp_sym_table, image.extern_mix_sym_table, image.extern_out_sym_table})
+        sym_tables.push_back(add_sym_table(i));
+
+    ir_file::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ir_file::magic, sizeof(header.magic));
+    header.version = ir_file::version;
+    header.program = add_stmt(image.program);
+    header.expected_checksum = image.expected_checksum;
+    std::vector<uint32_t> out_avail_members;
+    for (auto i : image.out_avail_members)
+        out_avail_members.push_back(add_expr(i));
+    header.out_avail_members = add_list(out_avail_members);
+    header.seed = image.seed;
+    header.gen_state = add_string(image.gen_state);
+
+    std::string buffer (sizeof(header), '\0');
+    auto add_section = [&buffer] (ir_file::Section& section, const void* ptr, uint64_t num, uint64_t size) {
+        buffer.resize(align_offset(buffer.size()), '\0');
+        section.offset = buffer.size();
+        section.num = num;
+        buffer.append((const char*) ptr, num * size);
+    };
+    add_section(header.types, types.data(), types.size(), sizeof(ir_file::TypeRecord));
+    add_section(header.struct_members, struct_members.data(), struct_members.size(), sizeof(ir_file::StructMemberRecord));
+    add_section(header.data, data.data(), data.size(), sizeof(ir_file::DataRecord));
+    add_section(header.exprs, exprs.data(), exprs.size(), sizeof(ir_file::ExprRecord));
+    add_section(header.stmts, stmts.data(), stmts.size(), sizeof(ir_file::StmtRecord));
+    add_section(header.sym_tables, sym_tables.data(), sym_tables.size(), sizeof(ir_file::SymTableRecord));
+    add_section(header.index_pool, index_pool.data(), index_pool.size(), sizeof(uint32_t));
+    add_section(header.string_pool, string_pool.data(), string_pool.size(), sizeof(char));
+    memcpy(&buffer[0], &header, sizeof(header));
+
+    std::ofstream out_file (file_name, std::ios::binary);
+    out_file.write(buffer.data(), buffer.size());
+    if (!out_file) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't write " << file_name << " in IRWriter::write" << std::endl;
+        exit(-1);
+    }
+}
+
+IRReader::IRReader (std::string _file_name) : file_name(_file_name), file_data(NULL), file_size(0), header(NULL) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || (uint64_t) file_stat.st_size < sizeof(ir_file::Header)) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't read " << file_name << " in IRReader::IRReader" << std::endl;
+        exit(-1);
+    }
+    file_size = file_stat.st_size;
+    void* mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't map " << file_name << " in IRReader::IRReader" << std::endl;
+        exit(-1);
+    }
+    file_data = (const char*) mapped;
+    header = (const ir_file::Header*) file_data;
+    if (memcmp(header->magic, ir_file::magic, sizeof(ir_file::magic)) != 0 || header->version != ir_file::version) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": " << file_name << " isn't IR file of version "
+                  << ir_file::version << " in IRReader::IRReader" << std::endl;
+        exit(-1);
+    }
+    // Sections are checked before any allocation, so corrupted header can't cause huge allocations
+    check_section<ir_file::TypeRecord>(header->types);
+    check_section<ir_file::StructMemberRecord>(header->struct_members);
+    check_section<ir_file::DataRecord>(header->data);
+    check_section<ir_file::ExprRecord>(header->exprs);
+    check_section<ir_file::StmtRecord>(header->stmts);
+    check_section<ir_file::SymTableRecord>(header->sym_tables);
+    check_section<uint32_t>(header->index_pool);
+    check_section<char>(header->string_pool);
+    types.resize(header->types.num);
+    struct_members.resize(header->struct_members.num);
+    data.resize(header->data.num);
+    exprs.resize(header->exprs.num);
+}
+
+IRReader::~IRReader () {
+    munmap((void*) file_data, file_size);
+}
+
+template <typename T>
+void IRReader::check_section (ir_file::Section section) {
+    if (section.offset % alignof(T) != 0 || section.offset > file_size ||
+        section.num > (file_size - section.offset) / sizeof(T)) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad section in " << file_name << " in IRReader::check_section" << std::endl;
+        exit(-1);
+    }
+}
+
+// All sections are checked in IRReader::IRReader
+template <typename T>
+const T* IRReader::get_section (ir_file::Section section) {
+    return (const T*) (file_data + section.offset);
+}
+
+static void check_idx (uint32_t idx, uint64_t num, std::string file_name) {
+    if (idx >= num) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad index in " << file_name << std::endl;
+        exit(-1);
+    }
+}
+
+std::vector<uint32_t> IRReader::get_list (ir_file::List list) {
+    const uint32_t* index_pool = get_section<uint32_t>(header->index_pool);
+    if ((uint64_t) list.offset + list.num > header->index_pool.num) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad list in " << file_name << " in IRReader::get_list" << std::endl;
+        exit(-1);
+    }
+    return std::vector<uint32_t>(index_pool + list.offset, index_pool + list.offset + list.num);
+}
+
+std::string IRReader::get_string (uint32_t offset) {
+    const char* string_pool = get_section<char>(header->string_pool);
+    check_idx(offset, header->string_pool.num, file_name);
+    return std::string(string_pool + offset, strnlen(string_pool + offset, header->string_pool.num - offset));
+}
+
+std::shared_ptr<Type> IRReader::get_type (uint32_t idx) {
+    check_idx(idx, types.size(), file_name);
+    if (types.at(idx) != NULL)
+        return types.at(idx);
+
+    const ir_file::TypeRecord& rec = get_section<ir_file::TypeRecord>(header->types) [idx];
+    std::shared_ptr<Type> ret;
+    if (rec.type_id == Type::TypeID::STRUCT_TYPE) {
+        std::shared_ptr<StructType> struct_type = std::make_shared<StructType>(get_string(rec.name), (Type::Mod) rec.modifier, rec.is_static, rec.align);
+        // Shadow members are named members in the same order, interleaved with unnamed bit-fields
+        std::vector<uint32_t> members = get_list(rec.members);
+        uint64_t member_num = 0;
+        for (auto i : get_list(rec.shadow_members)) {
+            std::shared_ptr<StructType::StructMember> shadow_member = get_struct_member(i);
+            if (shadow_member->get_name() != "" && member_num < members.size())
+                struct_type->add_member(get_struct_member(members.at(member_num++)));
+            else
+                struct_type->add_shadow_member(shadow_member->get_type());
+        }
+        struct_type->set_nest_depth(rec.nest_depth);
+        ret = struct_type;
+    }
+    else if (rec.is_bit_field) {
+        ret = std::make_shared<BitField>((Type::IntegerTypeID) rec.int_type_id, rec.bit_field_width, (Type::Mod) rec.modifier);
+        ret->set_is_static(rec.is_static);
+        ret->set_align(rec.align);
+    }
+    else
+        ret = IntegerType::init((Type::IntegerTypeID) rec.int_type_id, (Type::Mod) rec.modifier, rec.is_static, rec.align);
+    types.at(idx) = ret;
+    return ret;
+}
+
+std::shared_ptr<StructType::StructMember> IRReader::get_struct_member (uint32_t idx) {
+    check_idx(idx, struct_members.size(), file_name);
+    if (struct_members.at(idx) != NULL)
+        return struct_members.at(idx);
+
+    const ir_file::StructMemberRecord& rec = get_section<ir_file::StructMemberRecord>(header->struct_members) [idx];
+    struct_members.at(idx) = std::make_shared<StructType::StructMember>(get_type(rec.type), get_string(rec.name));
+    return struct_members.at(idx);
+}
+
+std::shared_ptr<Data> IRReader::get_data (uint32_t idx) {
+    check_idx(idx, data.size(), file_name);
+    if (data.at(idx) != NULL)
+        return data.at(idx);
+
+    const ir_file::DataRecord& rec = get_section<ir_file::DataRecord>(header->data) [idx];
+    std::shared_ptr<Data> ret;
+    if (rec.owner != ir_file::none)
+        ret = std::static_pointer_cast<Struct>(get_data(rec.owner))->get_member(rec.member_num);
+    else if (rec.class_id == Data::VarClassID::STRUCT)
+        ret = std::make_shared<Struct>(get_string(rec.name), std::static_pointer_cast<StructType>(get_type(rec.type)));
+    else
+        ret = std::make_shared<ScalarVariable>(get_string(rec.name), std::static_pointer_cast<IntegerType>(get_type(rec.type)));
+
+    if (ret == NULL || ret->get_class_id() != rec.class_id) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad data in " << file_name << " in IRReader::get_data" << std::endl;
+        exit(-1);
+    }
+    if (rec.class_id == Data::VarClassID::VAR) {
+        std::shared_ptr<ScalarVariable> scalar_var = std::static_pointer_cast<ScalarVariable>(ret);
+        scalar_var->set_min(form_val(rec.min));
+        scalar_var->set_max(form_val(rec.max));
+        scalar_var->set_init_value(form_val(rec.init_val));
+        scalar_var->set_cur_value(form_val(rec.cur_val));
+    }
+    data.at(idx) = ret;
+    return ret;
+}
+
+std::shared_ptr<Expr> IRReader::get_expr (uint32_t idx) {
+    check_idx(idx, exprs.size(), file_name);
+    if (exprs.at(idx) != NULL)
+        return exprs.at(idx);
+
+    const ir_file::ExprRecord& rec = get_section<ir_file::ExprRecord>(header->exprs) [idx];
+    std::shared_ptr<Expr> ret;
+    switch (rec.id) {
+        case Node::NodeID::VAR_USE:
+            ret = std::make_shared<VarUseExpr>(get_data(rec.ref));
+            break;
+        case Node::NodeID::CONST:
+            ret = std::make_shared<ConstExpr>(form_val(rec.val));
+            break;
+        case Node::NodeID::TYPE_CAST:
+            ret = std::make_shared<TypeCastExpr>(get_expr(rec.args[0]), get_type(rec.ref), rec.op);
+            break;
+        case Node::NodeID::UNARY: {
+            std::shared_ptr<Expr> arg = get_expr(rec.args[0]);
+            ret = std::make_shared<UnaryExpr>((UnaryExpr::Op) rec.op, form_placeholder(arg));
+            ret->set_operand(0, arg);
+            break;
+        }
+        case Node::NodeID::BINARY: {
+            std::shared_ptr<Expr> lhs = get_expr(rec.args[0]);
+            std::shared_ptr<Expr> rhs = get_expr(rec.args[1]);
+            ret = std::make_shared<BinaryExpr>((BinaryExpr::Op) rec.op, form_placeholder(lhs), form_placeholder(rhs));
+            ret->set_operand(0, lhs);
+            ret->set_operand(1, rhs);
+            break;
+        }
+        case Node::NodeID::ASSIGN: {
+            std::shared_ptr<Expr> from = get_expr(rec.args[1]);
+            std::shared_ptr<AssignExpr> assign_expr = std::make_shared<AssignExpr>(get_expr(rec.args[0]), form_placeholder(from), false);
+            assign_expr->set_operand(0, from);
+            assign_expr->set_taken(rec.op);
+            ret = assign_expr;
+            break;
+        }
+        case Node::NodeID::MEMBER:
+            if (rec.ref != ir_file::none)
+                ret = std::make_shared<MemberExpr>(std::static_pointer_cast<Struct>(get_data(rec.ref)), rec.op);
+            else
+                ret = std::make_shared<MemberExpr>(std::static_pointer_cast<MemberExpr>(get_expr(rec.args[0])), rec.op);
+            break;
+        default:
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad expr in " << file_name << " in IRReader::get_expr" << std::endl;
+            exit(-1);
+    }
+    exprs.at(idx) = ret;
+    return ret;
+}
+
+std::shared_ptr<Stmt> IRReader::get_stmt (uint32_t idx) {
+    check_idx(idx, header->stmts.num, file_name);
+    const ir_file::StmtRecord& rec = get_section<ir_file::StmtRecord>(header->stmts) [idx];
+    switch (rec.id) {
+        case Node::NodeID::DECL: {
+            std::shared_ptr<Expr> init = rec.expr != ir_file::none ? get_expr(rec.expr) : NULL;
+            return std::make_shared<DeclStmt>(get_data(rec.data), init, rec.is_extern);
+        }
+        case Node::NodeID::EXPR:
+            return std::make_shared<ExprStmt>(get_expr(rec.expr));
+        case Node::NodeID::SCOPE: {
+            std::shared_ptr<ScopeStmt> ret = std::make_shared<ScopeStmt>();
+            for (auto i : get_list(rec.stmts))
+                ret->add_stmt(get_stmt(i));
+            return ret;
+        }
+        case Node::NodeID::IF: {
+            std::shared_ptr<ScopeStmt> else_branch = NULL;
+            if (rec.branches[1] != ir_file::none)
+                else_branch = std::static_pointer_cast<ScopeStmt>(get_stmt(rec.branches[1]));
+            return std::make_shared<IfStmt>(get_expr(rec.expr), std::static_pointer_cast<ScopeStmt>(get_stmt(rec.branches[0])), else_branch);
+        }
+        default:
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": bad stmt in " << file_name << " in IRReader::get_stmt" << std::endl;
+            exit(-1);
+    }
+}
+
+std::shared_ptr<SymbolTable> IRReader::get_sym_table (uint32_t idx) {
+    check_idx(idx, header->sym_tables.num, file_name);
+    const ir_file::SymTableRecord& rec = get_section<ir_file::SymTableRecord>(header->sym_tables) [idx];
+    std::shared_ptr<SymbolTable> ret = std::make_shared<SymbolTable>();
+    for (auto i : get_list(rec.variables))
+        ret->add_variable(std::static_pointer_cast<ScalarVariable>(get_data(i)));
+    for (auto i : get_list(rec.struct_types))
+        ret->add_struct_type(std::static_pointer_cast<StructType>(get_type(i)));
+    // SymbolTable::add_struct would generate new available members, so the saved ones are used
+    for (auto i : get_list(rec.structs))
+        ret->get_structs().push_back(std::static_pointer_cast<Struct>(get_data(i)));
+    for (auto i : get_list(rec.avail_members))
+        ret->get_avail_members().push_back(std::static_pointer_cast<MemberExpr>(get_expr(i)));
+    for (auto i : get_list(rec.avail_const_members))
+        ret->get_avail_const_members().push_back(std::static_pointer_cast<MemberExpr>(get_expr(i)));
+    return ret;
+}
+
+IRImage IRReader::read () {
+    // Values of struct members should be restored even if they are not referenced
+    for (uint32_t i = 0; i < data.size(); ++i)
+        get_data(i);
+
+    IRImage ret;
+    ret.extern_inp_sym_table = get_sym_table(0);
+    ret.extern_mix_sym_table = get_sym_table(1);
+    ret.extern_out_sym_table = get_sym_table(2);
+    ret.program = std::static_pointer_cast<ScopeStmt>(get_stmt(header->program));
+    ret.expected_checksum = header->expected_checksum;
+    for (auto i : get_list(header->out_avail_members))
+        ret.out_avail_members.push_back(std::static_pointer_cast<MemberExpr>(get_expr(i)));
+    ret.seed = header->seed;
+    ret.gen_state = get_string(header->gen_state);
+    return ret;
+}
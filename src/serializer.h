@@ -0,0 +1,202 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <map>
+
+#include "sym_table.h"
+#include "stmt.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rl {
+
+// Binary IR file consists of header and tables of fixed-size records (types, struct members, data, expressions,
+// statements and symbol tables), which refer to each other by index. Variable-length lists are stored in
+// index pool, names - in string pool. All offsets are aligned, so mapped file is read in place without parsing.
+// Values of expressions are not stored: they are re-propagated after load.
+namespace ir_file {
+    static const char magic [8] = {'Y', 'A', 'R', 'P', 'G', 'I', 'R', '\0'};
+    static const uint32_t version = 1;
+    static const uint32_t none = UINT32_MAX;
+
+    struct Section {
+        uint64_t offset;
+        uint64_t num;
+    };
+
+    struct List {
+        uint32_t offset;
+        uint32_t num;
+    };
+
+    struct Header {
+        char magic [8];
+        uint32_t version;
+        uint32_t program;
+        uint64_t expected_checksum;
+        uint64_t seed;
+        // Output struct members, which are available for new bodies of foo () (see Master::generate_body)
+        List out_avail_members;
+        // State of generator (see RandValGen::get_state) in string pool
+        uint32_t gen_state;
+        uint32_t pad;
+        Section types;
+        Section struct_members;
+        Section data;
+        Section exprs;
+        Section stmts;
+        Section sym_tables;
+        Section index_pool;
+        Section string_pool;
+    };
+
+    struct ValRecord {
+        uint64_t val;
+        uint32_t int_type_id;
+        uint32_t ub;
+    };
+
+    struct TypeRecord {
+        uint32_t type_id;
+        uint32_t int_type_id;
+        uint32_t is_bit_field;
+        uint32_t modifier;
+        uint32_t is_static;
+        uint32_t name;
+        uint64_t align;
+        uint64_t bit_field_width;
+        uint64_t nest_depth;
+        List members;
+        List shadow_members;
+    };
+
+    struct StructMemberRecord {
+        uint32_t type;
+        uint32_t name;
+    };
+
+    // Struct members are created with their struct, so they are referenced through the owner
+    struct DataRecord {
+        uint32_t class_id;
+        uint32_t type;
+        uint32_t name;
+        uint32_t owner;
+        uint32_t member_num;
+        uint32_t pad;
+        ValRecord min;
+        ValRecord max;
+        ValRecord init_val;
+        ValRecord cur_val;
+    };
+
+    struct ExprRecord {
+        uint32_t id;
+        uint32_t op; // Operation, identifier of member, is_implicit of cast or taken of assignment
+        uint32_t ref; // Variable, struct or type
+        uint32_t args [2];
+        uint32_t pad;
+        ValRecord val;
+    };
+
+    struct StmtRecord {
+        uint32_t id;
+        uint32_t is_extern;
+        uint32_t data;
+        uint32_t expr;
+        uint32_t branches [2];
+        List stmts;
+    };
+
+    struct SymTableRecord {
+        List variables;
+        List struct_types;
+        List structs;
+        List avail_members;
+        List avail_const_members;
+    };
+}
+
+// Everything, which is required to re-emit generated test
+struct IRImage {
+    std::shared_ptr<ScopeStmt> program;
+    std::shared_ptr<SymbolTable> extern_inp_sym_table;
+    std::shared_ptr<SymbolTable> extern_mix_sym_table;
+    std::shared_ptr<SymbolTable> extern_out_sym_table;
+    uint64_t expected_checksum;
+    std::vector<std::shared_ptr<MemberExpr>> out_avail_members;
+    uint64_t seed;
+    std::string gen_state;
+};
+
+class IRWriter {
+    public:
+        IRWriter () {}
+        void write (std::string file_name, IRImage image);
+
+    private:
+        uint32_t add_type (std::shared_ptr<Type> type);
+        uint32_t add_struct_member (std::shared_ptr<StructType::StructMember> member);
+        uint32_t add_data (std::shared_ptr<Data> data, uint32_t owner = ir_file::none, uint32_t member_num = 0);
+        uint32_t add_expr (std::shared_ptr<Expr> expr);
+        uint32_t add_stmt (std::shared_ptr<Stmt> stmt);
+        ir_file::SymTableRecord add_sym_table (std::shared_ptr<SymbolTable> sym_table);
+        uint32_t add_string (std::string str);
+        ir_file::List add_list (std::vector<uint32_t> list);
+
+        std::map<Type*, uint32_t> type_idx;
+        std::map<StructType::StructMember*, uint32_t> struct_member_idx;
+        std::map<Data*, uint32_t> data_idx;
+        std::map<Expr*, uint32_t> expr_idx;
+        std::vector<ir_file::TypeRecord> types;
+        std::vector<ir_file::StructMemberRecord> struct_members;
+        std::vector<ir_file::DataRecord> data;
+        std::vector<ir_file::ExprRecord> exprs;
+        std::vector<ir_file::StmtRecord> stmts;
+        std::vector<uint32_t> index_pool;
+        std::string string_pool;
+};
+
+class IRReader {
+    public:
+        IRReader (std::string file_name);
+        ~IRReader ();
+        IRImage read ();
+
+    private:
+        template <typename T> void check_section (ir_file::Section section);
+        template <typename T> const T* get_section (ir_file::Section section);
+        std::vector<uint32_t> get_list (ir_file::List list);
+        std::string get_string (uint32_t offset);
+        std::shared_ptr<Type> get_type (uint32_t idx);
+        std::shared_ptr<StructType::StructMember> get_struct_member (uint32_t idx);
+        std::shared_ptr<Data> get_data (uint32_t idx);
+        std::shared_ptr<Expr> get_expr (uint32_t idx);
+        std::shared_ptr<Stmt> get_stmt (uint32_t idx);
+        std::shared_ptr<SymbolTable> get_sym_table (uint32_t idx);
+
+        std::string file_name;
+        const char* file_data;
+        uint64_t file_size;
+        const ir_file::Header* header;
+        std::vector<std::shared_ptr<Type>> types;
+        std::vector<std::shared_ptr<StructType::StructMember>> struct_members;
+        std::vector<std::shared_ptr<Data>> data;
+        std::vector<std::shared_ptr<Expr>> exprs;
+};
+}
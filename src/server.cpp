@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <dirent.h>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "server.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace rl;
+
+Server::Server (Handler _handler, unsigned _timeout) : handler(_handler), timeout(_timeout) {}
+
+void Server::serve () {
+    std::string request;
+    while (std::getline(std::cin, request)) {
+        std::istringstream request_stream (request);
+        std::vector<std::string> args;
+        std::string arg;
+        while (request_stream >> arg)
+            args.push_back(arg);
+        if (args.size() != 0)
+            process(args);
+    }
+}
+
+void Server::process (std::vector<std::string> args) {
+    std::string out_dir = "./";
+    for (unsigned i = 0; i + 1 < args.size(); ++i)
+        if (args.at(i) == "-d")
+            out_dir = args.at(i + 1);
+
+    int out_pipe [2];
+    int err_pipe [2];
+    if (pipe(out_pipe) != 0 || pipe(err_pipe) != 0) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't create pipe in Server::process" << std::endl;
+        exit(-1);
+    }
+    // Files are listed before the request, because modification time in seconds isn't precise enough
+    FileList old_files = list_files(out_dir);
+    // Buffered output would be duplicated in child process otherwise
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        dup2(out_pipe[1], STDOUT_FILENO);
+        dup2(err_pipe[1], STDERR_FILENO);
+        close(out_pipe[1]);
+        close(err_pipe[1]);
+        alarm(timeout);
+        std::vector<char*> argv;
+        std::string name = "yarpgen";
+        argv.push_back(&name[0]);
+        for (auto &i : args)
+            argv.push_back(&i[0]);
+        argv.push_back(NULL);
+        exit(handler(argv.size() - 1, argv.data()));
+    }
+    if (pid < 0) {
+        std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__ << ": can't fork in Server::process" << std::endl;
+        exit(-1);
+    }
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    std::string output = "";
+    std::string err_output = "";
+    read_pipes(out_pipe[0], err_pipe[0], output, err_output);
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+
+    std::string res = "fail";
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        res = "ok";
+    else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+        res = "timeout";
+    uint64_t cpu_time = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000ULL +
+                        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+    // Generator prints seed as "/*SEED <seed>*/" (to stderr, if test is streamed to stdout)
+    std::string seed = find_seed(err_output);
+    if (seed == "-")
+        seed = find_seed(output);
+
+    std::cout << res << " " << seed << " " << cpu_time << " " << output.size() << " " << err_output.size();
+    for (auto &i : get_new_files(out_dir, old_files))
+        std::cout << " " << i;
+    std::cout << "\n" << output << err_output;
+    std::cout.flush();
+}
+
+// Both pipes are read at the same time, so child process doesn't block on the full pipe
+void Server::read_pipes (int out_fd, int err_fd, std::string &output, std::string &err_output) {
+    struct pollfd fds [2] = {{out_fd, POLLIN, 0}, {err_fd, POLLIN, 0}};
+    std::string* outputs [2] = {&output, &err_output};
+    unsigned open_num = 2;
+    char buf [4096];
+    while (open_num > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (unsigned i = 0; i < 2; ++i) {
+            // poll ignores negative fds, so closed pipes are skipped
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+            ssize_t len = read(fds[i].fd, buf, sizeof(buf));
+            if (len > 0)
+                outputs[i]->append(buf, len);
+            else if (len == 0 || errno != EINTR) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                --open_num;
+            }
+        }
+    }
+    for (auto &i : fds)
+        if (i.fd >= 0)
+            close(i.fd);
+}
+
+std::string Server::find_seed (const std::string &output) {
+    size_t seed_pos = output.find("/*SEED ");
+    if (seed_pos == std::string::npos)
+        return "-";
+    seed_pos += std::string("/*SEED ").size();
+    size_t end_pos = output.find("*/", seed_pos);
+    if (end_pos == std::string::npos)
+        return "-";
+    return output.substr(seed_pos, end_pos - seed_pos);
+}
+
+Server::FileList Server::list_files (std::string dir) {
+    FileList ret;
+    DIR* dir_stream = opendir(dir.c_str());
+    if (dir_stream == NULL)
+        return ret;
+    struct dirent* entry = NULL;
+    while ((entry = readdir(dir_stream)) != NULL) {
+        struct stat file_stat;
+        std::string name = entry->d_name;
+        if (stat((dir + "/" + name).c_str(), &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+            uint64_t mtime = file_stat.st_mtim.tv_sec * 1000000000ULL + file_stat.st_mtim.tv_nsec;
+            ret[name] = std::make_pair(mtime, (uint64_t) file_stat.st_size);
+        }
+    }
+    closedir(dir_stream);
+    return ret;
+}
+
+std::vector<std::string> Server::get_new_files (std::string dir, const FileList &old_files) {
+    std::vector<std::string> ret;
+    for (auto &i : list_files(dir)) {
+        auto old_file = old_files.find(i.first);
+        if (old_file == old_files.end() || old_file->second != i.second)
+            ret.push_back(i.first);
+    }
+    return ret;
+}
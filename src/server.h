@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rl {
+
+// Server generates tests on request, so test harness doesn't pay for exec and startup of yarpgen for every test.
+// Request is a line with usual command line options of yarpgen (e.g. "-q -s 42 -p c -d out"). It is served by
+// forked process, which calls handler with these options. Fork (instead of generation in the server itself)
+// keeps global state of generator (e.g. counters of names) the same as in a standalone run, so every test can be
+// reproduced by yarpgen with the same options.
+// Reply is a line "<ok|fail|timeout> <seed> <cpu time in ms> <length of stdout> <length of stderr> <created files>",
+// followed by stdout and stderr of the request. Seed is "-", if generator hasn't printed it. Created files are files
+// in output folder, which didn't exist before the request or whose modification time (in nanoseconds) or size were
+// changed by the request.
+class Server {
+    public:
+        typedef int (*Handler) (int argc, char* argv[]);
+
+        // Timeout (in seconds) is applied to every request, 0 means no timeout
+        Server (Handler _handler, unsigned _timeout);
+        // Serves requests from stdin until it is closed
+        void serve ();
+
+    private:
+        void process (std::vector<std::string> args);
+        static void read_pipes (int out_fd, int err_fd, std::string &output, std::string &err_output);
+        static std::string find_seed (const std::string &output);
+        // Modification time in nanoseconds and size of every regular file in the folder
+        typedef std::map<std::string, std::pair<uint64_t, uint64_t>> FileList;
+        static FileList list_files (std::string dir);
+        static std::vector<std::string> get_new_files (std::string dir, const FileList &old_files);
+
+        Handler handler;
+        unsigned timeout;
+};
+}
@@ -50,6 +50,16 @@ std::shared_ptr<DeclStmt> DeclStmt::generate (std::shared_ptr<Context> ctx, std:
     return ret;
 }
 
+UB DeclStmt::repropagate_value (bool taken) {
+    if (init == NULL)
+        return NoUB;
+    UB ret_ub = init->repropagate_value();
+    std::shared_ptr<ScalarVariable> data_var = std::static_pointer_cast<ScalarVariable>(data);
+    std::shared_ptr<TypeCastExpr> cast_type = std::make_shared<TypeCastExpr>(init, data_var->get_type());
+    data_var->set_init_value(std::static_pointer_cast<ScalarVariable>(cast_type->get_value())->get_cur_value());
+    return taken ? ret_ub : NoUB;
+}
+
 std::string DeclStmt::emit (std::string offset) {
     std::string ret = offset;
     ret += data->get_type()->get_is_static() && !is_extern ? "static " : "";
@@ -90,9 +100,6 @@ std::string DeclStmt::emit (std::string offset) {
 }
 
 std::shared_ptr<ScopeStmt> ScopeStmt::generate (std::shared_ptr<Context> ctx) {
-    if (ctx->get_parent_ctx() == NULL)
-        form_extern_sym_table(ctx);
-
     std::shared_ptr<ScopeStmt> ret = std::make_shared<ScopeStmt>();
 
     std::vector<std::shared_ptr<Expr>> inp = form_inp_from_ctx(ctx);
@@ -125,7 +132,12 @@ std::shared_ptr<ScopeStmt> ScopeStmt::generate (std::shared_ptr<Context> ctx) {
                 }
             }
             else {
-                if (out_rata_type == GenPolicy::OutDataTypeID::VAR || ctx->get_extern_out_sym_table()->get_avail_members().size() == 0) {
+                if ((out_rata_type == GenPolicy::OutDataTypeID::VAR || ctx->get_extern_out_sym_table()->get_avail_members().size() == 0) &&
+                    !ctx->get_gen_policy()->get_allow_new_out_vars() && ctx->get_extern_out_sym_table()->get_variables().size() != 0) {
+                    int out_num = rand_val_gen->get_rand_value<int>(0, ctx->get_extern_out_sym_table()->get_variables().size() - 1);
+                    assign_lhs = std::make_shared<VarUseExpr>(ctx->get_extern_out_sym_table()->get_variables().at(out_num));
+                }
+                else if (out_rata_type == GenPolicy::OutDataTypeID::VAR || ctx->get_extern_out_sym_table()->get_avail_members().size() == 0) {
                     std::shared_ptr<ScalarVariable> out_var = ScalarVariable::generate(ctx);
                     ctx->get_extern_out_sym_table()->add_variable (out_var);
                     assign_lhs = std::make_shared<VarUseExpr>(out_var);
@@ -221,6 +233,15 @@ void ScopeStmt::form_extern_sym_table(std::shared_ptr<Context> ctx) {
     }
 }
 
+UB ScopeStmt::repropagate_value (bool taken) {
+    for (auto i : scope) {
+        UB ret_ub = i->repropagate_value(taken);
+        if (ret_ub != NoUB)
+            return ret_ub;
+    }
+    return NoUB;
+}
+
 std::string ScopeStmt::emit (std::string offset) {
     std::string ret = offset + "{\n";
     for (auto i : scope)
@@ -229,6 +250,38 @@ std::string ScopeStmt::emit (std::string offset) {
     return ret;
 }
 
+ExprStmt::ExprStmt (std::shared_ptr<Expr> _expr) : Stmt(Node::NodeID::EXPR), expr(_expr), taken(false), expected_val(0), checkpoint_id(-1) {
+    if (expr->get_id() != Node::NodeID::ASSIGN)
+        return;
+    taken = std::static_pointer_cast<AssignExpr>(expr)->get_taken();
+    form_expected_val();
+}
+
+void ExprStmt::form_expected_val () {
+    std::shared_ptr<AssignExpr> assign_expr = std::static_pointer_cast<AssignExpr>(expr);
+    std::shared_ptr<TypeCastExpr> to_ullint = std::make_shared<TypeCastExpr>(assign_expr->get_to(), IntegerType::init(Type::IntegerTypeID::ULLINT), true);
+    expected_val = std::static_pointer_cast<ScalarVariable>(to_ullint->get_value())->get_cur_value().val.ullint_val;
+}
+
+UB ExprStmt::repropagate_value (bool _taken) {
+    if (expr->get_id() != Node::NodeID::ASSIGN)
+        return _taken ? expr->repropagate_value() : NoUB;
+    taken = _taken;
+    std::static_pointer_cast<AssignExpr>(expr)->set_taken(taken);
+    UB ret_ub = expr->repropagate_value();
+    form_expected_val();
+    return taken ? ret_ub : NoUB;
+}
+
+std::string ExprStmt::emit (std::string offset) {
+    std::string ret = offset + expr->emit() + ";";
+    if (checkpoint_id != -1) {
+        std::shared_ptr<TypeCastExpr> to_ullint = std::make_shared<TypeCastExpr>(std::static_pointer_cast<AssignExpr>(expr)->get_to(), IntegerType::init(Type::IntegerTypeID::ULLINT));
+        ret += "\n" + offset + "checkpoint_vals [" + std::to_string(checkpoint_id) + "] = " + to_ullint->emit() + ";";
+    }
+    return ret;
+}
+
 std::shared_ptr<ExprStmt> ExprStmt::generate (std::shared_ptr<Context> ctx, std::vector<std::shared_ptr<Expr>> inp, std::shared_ptr<Expr> out) {
     //TODO: now it can be only assign. Do we want something more?
     std::shared_ptr<Expr> from = ArithExpr::generate(ctx, inp);
@@ -266,6 +319,17 @@ std::shared_ptr<IfStmt> IfStmt::generate (std::shared_ptr<Context> ctx, std::vec
     return std::make_shared<IfStmt>(cond, then_br, else_br);
 }
 
+UB IfStmt::repropagate_value (bool _taken) {
+    UB ret_ub = cond->repropagate_value();
+    if (_taken && ret_ub != NoUB)
+        return ret_ub;
+    taken = count_if_taken(cond);
+    ret_ub = if_branch->repropagate_value(_taken && taken);
+    if (ret_ub != NoUB || else_branch == NULL)
+        return ret_ub;
+    return else_branch->repropagate_value(_taken && !taken);
+}
+
 std::string IfStmt::emit (std::string offset) {
     std::string ret = offset;
     ret += "if (" + cond->emit() + ")\n";
@@ -32,14 +32,20 @@ class Context;
 class Stmt : public Node {
     public:
         Stmt (Node::NodeID _id) : Node(_id) {};
+        // Recomputes values of all expressions in program order. UB is reported only for executed (taken) code.
+        virtual UB repropagate_value (bool taken) = 0;
 };
 
 class DeclStmt : public Stmt {
     public:
         DeclStmt (std::shared_ptr<Data> _data, std::shared_ptr<Expr> _init, bool _is_extern = false);
         void set_is_extern (bool _is_extern) { is_extern = _is_extern; }
+        bool get_is_extern () { return is_extern; }
         std::shared_ptr<Data> get_data () { return data; }
+        std::shared_ptr<Expr> get_init () { return init; }
+        void set_init (std::shared_ptr<Expr> _init) { init = _init; }
         std::string emit (std::string offset = "");
+        UB repropagate_value (bool taken);
         static std::shared_ptr<DeclStmt> generate (std::shared_ptr<Context> ctx, std::vector<std::shared_ptr<Expr>> inp);
 
     private:
@@ -50,25 +56,41 @@ class DeclStmt : public Stmt {
 
 class ExprStmt : public Stmt {
     public:
-        ExprStmt (std::shared_ptr<Expr> _expr) : Stmt(Node::NodeID::EXPR), expr(_expr) {}
-        std::string emit (std::string offset = "") { return offset + expr->emit() + ";"; }
+        ExprStmt (std::shared_ptr<Expr> _expr);
+        std::shared_ptr<Expr> get_expr () { return expr; }
+        bool get_taken () { return taken; }
+        // Value of assigned variable right after the statement, converted to unsigned long long int
+        uint64_t get_expected_val () { return expected_val; }
+        // Statement with checkpoint stores assigned value to checkpoint_vals [checkpoint_id]
+        void set_checkpoint_id (int64_t _checkpoint_id) { checkpoint_id = _checkpoint_id; }
+        std::string emit (std::string offset = "");
+        UB repropagate_value (bool _taken);
         static std::shared_ptr<ExprStmt> generate (std::shared_ptr<Context> ctx, std::vector<std::shared_ptr<Expr>> inp, std::shared_ptr<Expr> out);
 
     private:
+        void form_expected_val ();
+
         std::shared_ptr<Expr> expr;
+        bool taken;
+        uint64_t expected_val;
+        int64_t checkpoint_id;
 };
 
 class ScopeStmt : public Stmt {
     public:
         ScopeStmt () : Stmt(Node::NodeID::SCOPE) {}
         void add_stmt (std::shared_ptr<Stmt> stmt) { scope.push_back(stmt); }
+        std::vector<std::shared_ptr<Stmt>>& get_scope () { return scope; }
         std::string emit (std::string offset = "");
+        UB repropagate_value (bool taken);
         static std::shared_ptr<ScopeStmt> generate (std::shared_ptr<Context> ctx);
+        // Expressions, which are available as inputs in given context
+        static std::vector<std::shared_ptr<Expr>> form_inp_from_ctx (std::shared_ptr<Context> ctx);
+        // Generates external variables and struct types. It should be called for root context before generate ().
+        static void form_extern_sym_table(std::shared_ptr<Context> ctx);
 
     private:
         static std::vector<std::shared_ptr<Expr>> form_const_inp_from_ctx (std::shared_ptr<Context> ctx);
-        static std::vector<std::shared_ptr<Expr>> form_inp_from_ctx (std::shared_ptr<Context> ctx);
-        static void form_extern_sym_table(std::shared_ptr<Context> ctx);
         std::vector<std::shared_ptr<Stmt>> scope;
 };
 
@@ -76,7 +98,13 @@ class IfStmt : public Stmt {
     public:
         IfStmt (std::shared_ptr<Expr> cond, std::shared_ptr<ScopeStmt> if_branch, std::shared_ptr<ScopeStmt> else_branch);
         static bool count_if_taken (std::shared_ptr<Expr> cond);
+        std::shared_ptr<Expr> get_cond () { return cond; }
+        void set_cond (std::shared_ptr<Expr> _cond) { cond = _cond; }
+        std::shared_ptr<ScopeStmt> get_if_branch () { return if_branch; }
+        std::shared_ptr<ScopeStmt> get_else_branch () { return else_branch; }
+        void set_else_branch (std::shared_ptr<ScopeStmt> _else_branch) { else_branch = _else_branch; }
         std::string emit (std::string offset = "");
+        UB repropagate_value (bool _taken);
         static std::shared_ptr<IfStmt> generate (std::shared_ptr<Context> ctx, std::vector<std::shared_ptr<Expr>> inp);
 
     private:
@@ -136,16 +136,15 @@ std::string SymbolTable::emit_single_struct_init (std::shared_ptr<MemberExpr> pa
     return ret;
 }
 
-std::string SymbolTable::emit_struct_check (std::string offset) {
-    std::string ret = "";
+std::vector<std::shared_ptr<Expr>> SymbolTable::form_struct_check_exprs () {
+    std::vector<std::shared_ptr<Expr>> ret;
     for (auto i : structs) {
-        ret += emit_single_struct_check(NULL, i, offset);
+        form_single_struct_check_exprs(NULL, i, ret);
     }
     return ret;
 }
 
-std::string SymbolTable::emit_single_struct_check (std::shared_ptr<MemberExpr> parent_memb_expr, std::shared_ptr<Struct> struct_var, std::string offset) {
-    std::string ret = "";
+void SymbolTable::form_single_struct_check_exprs (std::shared_ptr<MemberExpr> parent_memb_expr, std::shared_ptr<Struct> struct_var, std::vector<std::shared_ptr<Expr>>& check_exprs) {
     for (int j = 0; j < struct_var->get_num_of_members(); ++j) {
         std::shared_ptr<MemberExpr> member_expr;
         if  (parent_memb_expr != NULL)
@@ -154,21 +153,39 @@ std::string SymbolTable::emit_single_struct_check (std::shared_ptr<MemberExpr> p
             member_expr = std::make_shared<MemberExpr>(struct_var, j);
 
         if (struct_var->get_member(j)->get_type()->is_struct_type())
-            ret += emit_single_struct_check(member_expr, std::static_pointer_cast<Struct>(struct_var->get_member(j)), offset);
+            form_single_struct_check_exprs(member_expr, std::static_pointer_cast<Struct>(struct_var->get_member(j)), check_exprs);
         else
-            ret += offset + "hash(seed, " + member_expr->emit() + ");\n";
+            check_exprs.push_back(member_expr);
     }
-    return ret;
 }
 
-std::string SymbolTable::emit_variable_check (std::string offset) {
-    std::string ret = "";
-    for (auto i = variable.begin(); i != variable.end(); ++i) {
-        ret += offset + "hash(seed, " + (*i)->get_name() + ");\n";
+std::vector<std::shared_ptr<Expr>> SymbolTable::form_variable_check_exprs () {
+    std::vector<std::shared_ptr<Expr>> ret;
+    for (auto i : variable) {
+        ret.push_back(std::make_shared<VarUseExpr>(i));
     }
     return ret;
 }
 
+void SymbolTable::restore_init_values () {
+    for (auto i : variable)
+        i->set_init_value(i->get_init_value());
+    for (auto i : structs)
+        restore_single_struct_init_values(i);
+}
+
+void SymbolTable::restore_single_struct_init_values (std::shared_ptr<Struct> struct_var) {
+    for (int j = 0; j < struct_var->get_num_of_members(); ++j) {
+        if (struct_var->get_member(j)->get_class_id() == Data::VarClassID::STRUCT) {
+            restore_single_struct_init_values(std::static_pointer_cast<Struct>(struct_var->get_member(j)));
+        }
+        else {
+            std::shared_ptr<ScalarVariable> member = std::static_pointer_cast<ScalarVariable>(struct_var->get_member(j));
+            member->set_init_value(member->get_init_value());
+        }
+    }
+}
+
 Context::Context (GenPolicy _gen_policy, std::shared_ptr<Context> _parent_ctx, Node::NodeID _self_stmt_id, bool _taken) {
     gen_policy = std::make_shared<GenPolicy>(_gen_policy);
     parent_ctx = _parent_ctx;
@@ -48,19 +48,22 @@ class SymbolTable {
 
         std::string emit_variable_extern_decl (std::string offset = "");
         std::string emit_variable_def (std::string offset = "");
-        // TODO: rewrite with IR
-        std::string emit_variable_check (std::string offset = "");
         std::string emit_struct_type_static_memb_def (std::string offset = "");
         std::string emit_struct_type_def (std::string offset = "");
         std::string emit_struct_def (std::string offset = "");
         std::string emit_struct_extern_decl (std::string offset = "");
         std::string emit_struct_init (std::string offset = "");
-        std::string emit_struct_check (std::string offset = "");
+        // Expressions for every scalar, which should be hashed in checksum (in hashing order)
+        std::vector<std::shared_ptr<Expr>> form_variable_check_exprs ();
+        std::vector<std::shared_ptr<Expr>> form_struct_check_exprs ();
+        // Sets current values of all variables and struct members to their initial values
+        void restore_init_values ();
 
     private:
         void form_struct_member_expr (std::shared_ptr<MemberExpr> parent_memb_expr, std::shared_ptr<Struct> struct_var, bool ignore_const = false);
         std::string emit_single_struct_init (std::shared_ptr<MemberExpr> parent_memb_expr, std::shared_ptr<Struct> struct_var, std::string offset = "");
-        std::string emit_single_struct_check (std::shared_ptr<MemberExpr> parent_memb_expr, std::shared_ptr<Struct> struct_var, std::string offset = "");
+        void form_single_struct_check_exprs (std::shared_ptr<MemberExpr> parent_memb_expr, std::shared_ptr<Struct> struct_var, std::vector<std::shared_ptr<Expr>>& check_exprs);
+        void restore_single_struct_init_values (std::shared_ptr<Struct> struct_var);
 
         std::vector<std::shared_ptr<StructType>> struct_type;
         std::vector<std::shared_ptr<Struct>> structs;
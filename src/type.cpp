@@ -1693,12 +1693,19 @@ void TypeULLINT::dbg_dump () {
 std::shared_ptr<BitField> BitField::generate (std::shared_ptr<Context> ctx, bool is_unnamed) {
     Type::Mod modifier = ctx->get_gen_policy()->get_allowed_modifiers().at(rand_val_gen->get_rand_value<int>(0, ctx->get_gen_policy()->get_allowed_modifiers().size() - 1));
     IntegerType::IntegerTypeID int_type_id = (IntegerType::IntegerTypeID) rand_val_gen->get_rand_id(ctx->get_gen_policy()->get_allowed_int_types());
+    if (!ctx->get_gen_policy()->get_allow_wide_bit_fields() && int_type_id > Type::IntegerTypeID::UINT)
+        int_type_id = IntegerType::init(int_type_id)->get_is_signed() ? Type::IntegerTypeID::INT : Type::IntegerTypeID::UINT;
     std::shared_ptr<IntegerType> tmp_int_type = IntegerType::init(int_type_id);
     uint64_t min_bit_size = is_unnamed ? 0 : (tmp_int_type->get_bit_size() / ctx->get_gen_policy()->get_min_bit_field_size());
     //TODO: it cause different result for LLVM and GCC. See pr70733
 //    uint64_t max_bit_size = tmp_int_type->get_bit_size() * ctx->get_gen_policy()->get_max_bit_field_size();
      std::shared_ptr<IntegerType> int_type = IntegerType::init(Type::IntegerTypeID::INT);
     uint64_t max_bit_size = int_type->get_bit_size();
+    if (!ctx->get_gen_policy()->get_allow_wide_bit_fields()) {
+        // C requires width of bit-field not to exceed width of its type (and _Bool has width 1)
+        uint64_t type_width = int_type_id == Type::IntegerTypeID::BOOL ? 1 : tmp_int_type->get_bit_size();
+        max_bit_size = std::min(max_bit_size, type_width);
+    }
 
     uint64_t bit_size = rand_val_gen->get_rand_value<uint64_t>(min_bit_size, max_bit_size);
     return std::make_shared<BitField>(int_type_id, bit_size, modifier);
@@ -126,7 +126,9 @@ class StructType : public Type {
         uint64_t get_num_of_members () { return members.size(); }
         uint64_t get_num_of_shadow_members () { return shadow_members.size(); }
         uint64_t get_nest_depth () { return nest_depth; }
+        void set_nest_depth (uint64_t _nest_depth) { nest_depth = _nest_depth; }
         std::shared_ptr<StructMember> get_member (unsigned int num);
+        std::shared_ptr<StructMember> get_shadow_member (unsigned int num) { return shadow_members.at(num); }
         std::string get_definition (std::string offset = "");
         std::string get_static_memb_def (std::string offset = "");
         bool is_struct_type() { return true; }
@@ -151,6 +153,7 @@ enum UB {
     ShiftRhsLarge, // // Shift by large value
     NegShift, // Shift of negative value
     NoMemeber, // Can't find member of structure
+    BitFieldOvf, // Value doesn't fit into bit-field (not UB, but the value model doesn't support it)
     MaxUB
 };
 
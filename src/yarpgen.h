@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2015-2016, Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+// C API of libyarpgen. Tests are generated in memory, so no files are written and no process is spawned.
+// All calls are reentrant: every thread has its own state of generator. Generated test is the same as the output
+// of "yarpgen -s <seed>" with the same policy. Internal errors of generator terminate the process (like yarpgen).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output profiles (-p option of yarpgen)
+enum yarpgen_profile {
+    YARPGEN_CXX = 0,
+    YARPGEN_CXX_LIGHT = 1,
+    YARPGEN_C = 2
+};
+
+struct yarpgen_policy {
+    int profile;          // yarpgen_profile
+    int self_check;       // -c option
+    int use_checkpoints;  // -k option, files of checkpoint variant have "checkpoints/" prefix, it can't be used with bundles
+    int bundle_size;      // -b option, 1 means single test
+};
+
+struct yarpgen_file {
+    char* name;
+    char* data;           // Data is null-terminated
+    size_t size;
+};
+
+struct yarpgen_stats {
+    uint64_t test_num;    // Tests in bundles are counted separately
+    uint64_t gen_time_us;
+    uint64_t emit_time_us;
+    uint64_t file_num;
+    uint64_t total_size;  // Size of all files in bytes
+};
+
+struct yarpgen_output {
+    uint64_t seed;        // Actual seed (random one is chosen for seed 0)
+    uint64_t* expected_checksums;  // One for every test of bundle
+    size_t checksum_num;
+    struct yarpgen_file* files;
+    size_t file_num;
+    struct yarpgen_stats stats;
+};
+
+void yarpgen_default_policy (struct yarpgen_policy* policy);
+// Returns 0 on success and -1 if policy is invalid. Output should be released by yarpgen_free.
+int yarpgen_generate (uint64_t seed, const struct yarpgen_policy* policy, struct yarpgen_output* out);
+void yarpgen_free (struct yarpgen_output* out);
+// Accumulated statistics of all yarpgen_generate calls in the process
+void yarpgen_get_stats (struct yarpgen_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif